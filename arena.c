@@ -0,0 +1,66 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "common.h"
+
+Arena ar_new(usize block_size) {
+    return (Arena){.block_size = (block_size != 0) ? block_size : AR_BLOCK_SIZE};
+}
+
+void ar_free(Arena* a) {
+    ArenaBlock* b = a->head;
+    while (b != NULL) {
+        ArenaBlock* prev = b->prev;
+        free(b);
+        b = prev;
+    }
+    a->head = NULL;
+}
+
+// padding needed to align the next allocation in a block
+static usize ar_pad(ArenaBlock* b) {
+    uintptr_t at = (uintptr_t)&b->data[b->len];
+    return (AR_ALIGN - (at & (AR_ALIGN - 1))) & (AR_ALIGN - 1);
+}
+
+void* ar_alloc(Arena* a, usize size) {
+    if (a->block_size == 0)
+        a->block_size = AR_BLOCK_SIZE;
+
+    ArenaBlock* b = a->head;
+    if (b == NULL || ar_pad(b) + size > b->cap - b->len) {
+        usize cap = (size + AR_ALIGN > a->block_size) ? size + AR_ALIGN
+                                                      : a->block_size;
+        ArenaBlock* nb = malloc(sizeof(ArenaBlock) + cap);
+        check_alloc(nb);
+        *nb = (ArenaBlock){.cap = cap};
+
+        // a block of its own goes behind the current one, so the space left
+        // in that is not lost
+        if (b != NULL && cap > a->block_size) {
+            nb->prev = b->prev;
+            b->prev = nb;
+        } else {
+            nb->prev = b;
+            a->head = nb;
+        }
+        b = nb;
+    }
+
+    b->len += ar_pad(b);
+    void* res = &b->data[b->len];
+    b->len += size;
+    return res;
+}
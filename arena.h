@@ -0,0 +1,45 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include "common.h"
+
+// a bump allocator. memory comes out of big blocks, one after the other, and
+// is only ever given back all at once. nothing in an arena is ever moved.
+
+// every allocation is aligned to this.
+#define AR_ALIGN 16
+
+// default size of a block.
+#define AR_BLOCK_SIZE (64 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* prev;
+    usize len;
+    usize cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head; // the block that is being allocated from
+    usize block_size;
+} Arena;
+
+// no memory is allocated until the first ar_alloc. a block size of 0 means
+// AR_BLOCK_SIZE, so a zeroed arena is ready to use as well.
+Arena ar_new(usize block_size);
+void ar_free(Arena* a);
+
+// never returns null. anything bigger than the block size gets a block of its
+// own.
+void* ar_alloc(Arena* a, usize size);
+
+#endif // _ARENA_H
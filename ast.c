@@ -0,0 +1,352 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "common.h"
+
+#define AST_POOL_INITIAL 64
+
+Ast ast_new(void) {
+    return (Ast){0};
+}
+
+// every pool has to be in ast_pools
+typedef char ast_pools_are_all_there
+    [sizeof(Ast) == AST_NPOOLS * sizeof(((Ast*)0)->strings) ? 1 : -1];
+
+#define AST_REF(pool)                                                          \
+    (AstPoolRef) {                                                             \
+        (void**)&a->pool.data, &a->pool.len, &a->pool.cap,                     \
+            sizeof(*a->pool.data)                                              \
+    }
+
+void ast_pools(Ast* a, AstPoolRef res[AST_NPOOLS]) {
+    AstPoolRef pools[AST_NPOOLS] = {
+        AST_REF(idents), AST_REF(unaries), AST_REF(binaries),
+        AST_REF(indexes), AST_REF(calls), AST_REF(assigns),
+        AST_REF(ifs), AST_REF(literals), AST_REF(types),
+        AST_REF(array_types), AST_REF(fn_args), AST_REF(expr_lists),
+        AST_REF(branches), AST_REF(items), AST_REF(includes),
+        AST_REF(strings),
+    };
+    memcpy(res, pools, sizeof(pools));
+}
+
+void ast_free(Ast* a) {
+    AstPoolRef pools[AST_NPOOLS];
+    ast_pools(a, pools);
+    for (u32 i = 0; i < AST_NPOOLS; i++)
+        free(*pools[i].data);
+    *a = (Ast){0};
+}
+
+u32 ast_push_(void** data, u32* len, u32* cap, usize size, const void* nodes,
+              u32 n) {
+    // ids only have so many bits for the index, see expr.h
+    if (n > C_EXPR_INDEX_MAX - *len)
+        panic("too many nodes in one tree");
+
+    if (*len + n > *cap) {
+        u32 c = (*cap != 0) ? *cap : AST_POOL_INITIAL;
+        while (c < *len + n)
+            c *= 2;
+        *data = realloc(*data, size * c);
+        check_alloc(*data);
+        *cap = c;
+    }
+
+    u32 first = *len;
+    if (n != 0)
+        memcpy((char*)*data + size * first, nodes, size * n);
+    *len += n;
+    return first;
+}
+
+u32 ast_add_string(Ast* a, const char* s, u32 len) {
+    u32 off = ast_push(&a->strings, s, len);
+    ast_push(&a->strings, "", 1);
+    return off;
+}
+
+void ast_remap_syms(Ast* a, const u32* remap) {
+    for (u32 i = 0; i < a->idents.len; i++)
+        a->idents.data[i].sym = remap[a->idents.data[i].sym];
+    for (u32 i = 0; i < a->calls.len; i++)
+        a->calls.data[i].ident.sym = remap[a->calls.data[i].ident.sym];
+    for (u32 i = 0; i < a->fn_args.len; i++)
+        a->fn_args.data[i].ident.sym = remap[a->fn_args.data[i].ident.sym];
+}
+
+// whether `n` nodes from `first` on are all in a pool `len` long.
+static bool ast_run_ok(u32 first, u32 n, u32 len) {
+    return first <= len && n <= len - first;
+}
+
+static bool ast_string_ok(const Ast* a, u32 off, u32 len) {
+    return off < a->strings.len && len < a->strings.len - off &&
+           a->strings.data[off + len] == '\0';
+}
+
+static u32 ast_expr_pool_len(const Ast* a, C_ExprKind kind) {
+    u32 res = 0;
+    switch (kind) {
+        case C_EXPR_IDENTIFIER: res = a->idents.len; break;
+        case C_EXPR_UNARYOP: res = a->unaries.len; break;
+        case C_EXPR_BINOP: res = a->binaries.len; break;
+        case C_EXPR_ARRAY_INDEX: res = a->indexes.len; break;
+        case C_EXPR_FNCALL: res = a->calls.len; break;
+        case C_EXPR_ASSIGN: res = a->assigns.len; break;
+        case C_EXPR_IF: res = a->ifs.len; break;
+        case C_EXPR_LITERAL: res = a->literals.len; break;
+    }
+    return res;
+}
+
+static bool ast_expr_ok(const Ast* a, C_ExprId id, bool none_ok) {
+    if (id == C_EXPR_NONE)
+        return none_ok;
+    return C_EXPR_KIND(id) <= C_EXPR_LITERAL &&
+           C_EXPR_INDEX(id) < ast_expr_pool_len(a, C_EXPR_KIND(id));
+}
+
+// every node on its own: its ids, runs, symbols, strings and enums.
+static bool ast_check_nodes(const Ast* a, u32 nsyms) {
+    for (u32 i = 0; i < a->idents.len; i++) {
+        if (a->idents.data[i].sym >= nsyms)
+            return false;
+    }
+
+    for (u32 i = 0; i < a->unaries.len; i++) {
+        const C_UnaryExpr* n = &a->unaries.data[i];
+        if (n->op > C_UNARYOP_NOT || !ast_expr_ok(a, n->inner, false))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->binaries.len; i++) {
+        const C_BinaryExpr* n = &a->binaries.data[i];
+        if (n->op > C_BINARYOP_OR || !ast_expr_ok(a, n->lhs, false) ||
+            !ast_expr_ok(a, n->rhs, false))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->indexes.len; i++) {
+        const C_ArrayIndex* n = &a->indexes.data[i];
+        if (!ast_expr_ok(a, n->ident, false) ||
+            !ast_expr_ok(a, n->index, false))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->calls.len; i++) {
+        const C_FnCall* n = &a->calls.data[i];
+        if (n->ident.sym >= nsyms ||
+            !ast_run_ok(n->args, n->args_len, a->expr_lists.len))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->assigns.len; i++) {
+        const C_Assign* n = &a->assigns.data[i];
+        bool lhs_ok = false;
+        switch (n->lhs.kind) {
+            case C_LV_IDENTIFIER: {
+                lhs_ok = n->lhs.node < a->idents.len;
+            } break;
+            case C_LV_ARRAY_INDEX: {
+                lhs_ok = n->lhs.node < a->indexes.len;
+            } break;
+        }
+        if (!lhs_ok || (n->compound && n->op > C_BINARYOP_OR) ||
+            !ast_expr_ok(a, n->rhs, false))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->ifs.len; i++) {
+        const C_If* n = &a->ifs.data[i];
+        if (!ast_run_ok(n->branches, n->branches_len, a->branches.len))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->literals.len; i++) {
+        const C_Literal* n = &a->literals.data[i];
+        if (n->type > C_NULL || n->type == C_ANY ||
+            (n->type == C_STRING &&
+             !ast_string_ok(a, n->data.string.off, n->data.string.len)))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->types.len; i++) {
+        const C_Type* n = &a->types.data[i];
+        switch (n->kind) {
+            case C_TYPE_PRIMITIVE: {
+                if (n->data.primitive > C_NULL)
+                    return false;
+            } break;
+            case C_TYPE_ARRAY: {
+                if (n->data.array >= a->array_types.len)
+                    return false;
+            } break;
+            default: return false;
+        }
+    }
+
+    for (u32 i = 0; i < a->array_types.len; i++) {
+        const C_ArrayType* n = &a->array_types.data[i];
+        if (!ast_expr_ok(a, n->size, true) || n->inner >= a->types.len)
+            return false;
+    }
+
+    for (u32 i = 0; i < a->fn_args.len; i++) {
+        const C_FunctionArgument* n = &a->fn_args.data[i];
+        if (n->ident.sym >= nsyms || n->type >= a->types.len)
+            return false;
+    }
+
+    for (u32 i = 0; i < a->expr_lists.len; i++) {
+        if (!ast_expr_ok(a, a->expr_lists.data[i], false))
+            return false;
+    }
+
+    for (u32 i = 0; i < a->branches.len; i++) {
+        const C_If_Branch* n = &a->branches.data[i];
+        if (n->kind > C_IF_ELSE ||
+            !ast_expr_ok(a, n->cond, n->kind == C_IF_ELSE) ||
+            (n->kind == C_IF_ELSE && n->cond != C_EXPR_NONE) ||
+            !ast_run_ok(n->block.items, n->block.len, a->items.len))
+            return false;
+    }
+
+    // there are no statements yet
+    for (u32 i = 0; i < a->items.len; i++) {
+        if (!ast_expr_ok(a, a->items.data[i].expr, false))
+            return false;
+    }
+
+    return true;
+}
+
+// which nodes have been reached from the top level so far.
+typedef struct {
+    const Ast* a;
+    u8* exprs[C_EXPR_LITERAL + 1]; // by kind
+    u8* expr_lists;
+    u8* branches;
+    u8* items;
+} AstWalk;
+
+// marks node `i`, or returns false if it was already.
+static bool ast_mark(u8* seen, u32 i) {
+    if (seen[i])
+        return false;
+    seen[i] = 1;
+    return true;
+}
+
+static bool ast_walk_block(AstWalk* w, C_Block b);
+
+static bool ast_walk_expr(AstWalk* w, C_ExprId id) {
+    if (id == C_EXPR_NONE)
+        return true;
+
+    const Ast* a = w->a;
+    u32 i = C_EXPR_INDEX(id);
+    if (!ast_mark(w->exprs[C_EXPR_KIND(id)], i))
+        return false;
+
+    bool ok = true;
+    switch (C_EXPR_KIND(id)) {
+        case C_EXPR_IDENTIFIER:
+        case C_EXPR_LITERAL: break;
+        case C_EXPR_UNARYOP: {
+            ok = ast_walk_expr(w, a->unaries.data[i].inner);
+        } break;
+        case C_EXPR_BINOP: {
+            const C_BinaryExpr* n = &a->binaries.data[i];
+            ok = ast_walk_expr(w, n->lhs) && ast_walk_expr(w, n->rhs);
+        } break;
+        case C_EXPR_ARRAY_INDEX: {
+            const C_ArrayIndex* n = &a->indexes.data[i];
+            ok = ast_walk_expr(w, n->ident) && ast_walk_expr(w, n->index);
+        } break;
+        case C_EXPR_FNCALL: {
+            const C_FnCall* n = &a->calls.data[i];
+            for (u32 k = n->args; ok && k < n->args + n->args_len; k++)
+                ok = ast_mark(w->expr_lists, k) &&
+                     ast_walk_expr(w, a->expr_lists.data[k]);
+        } break;
+        case C_EXPR_ASSIGN: {
+            const C_Assign* n = &a->assigns.data[i];
+            C_ExprId lhs = (n->lhs.kind == C_LV_IDENTIFIER)
+                               ? C_EXPR_ID(C_EXPR_IDENTIFIER, n->lhs.node)
+                               : C_EXPR_ID(C_EXPR_ARRAY_INDEX, n->lhs.node);
+            ok = ast_walk_expr(w, lhs) && ast_walk_expr(w, n->rhs);
+        } break;
+        case C_EXPR_IF: {
+            const C_If* n = &a->ifs.data[i];
+            for (u32 k = n->branches; ok && k < n->branches + n->branches_len;
+                 k++) {
+                const C_If_Branch* b = &a->branches.data[k];
+                ok = ast_mark(w->branches, k) && ast_walk_expr(w, b->cond) &&
+                     ast_walk_block(w, b->block);
+            }
+        } break;
+    }
+    return ok;
+}
+
+static bool ast_walk_block(AstWalk* w, C_Block b) {
+    for (u32 k = b.items; k < b.items + b.len; k++) {
+        if (!ast_mark(w->items, k) ||
+            !ast_walk_expr(w, w->a->items.data[k].expr))
+            return false;
+    }
+    return true;
+}
+
+static u8* ast_marks(u32 len) {
+    u8* res = calloc(len + 1, 1);
+    check_alloc(res);
+    return res;
+}
+
+bool ast_check(const Ast* a, u32 nsyms, C_Block body) {
+    if (!ast_check_nodes(a, nsyms) ||
+        !ast_run_ok(body.items, body.len, a->items.len))
+        return false;
+
+    u32 at = 0;
+    for (u32 i = 0; i < a->includes.len; i++) {
+        const C_Include* inc = &a->includes.data[i];
+        if (inc->at < at || inc->at > body.len ||
+            !ast_string_ok(a, inc->path, inc->path_len))
+            return false;
+        at = inc->at;
+    }
+
+    // every node is reached at most once, so the walk ends, and so does
+    // anything else that goes down the tree
+    AstWalk w = {.a = a};
+    for (u32 k = 0; k <= C_EXPR_LITERAL; k++)
+        w.exprs[k] = ast_marks(ast_expr_pool_len(a, k));
+    w.expr_lists = ast_marks(a->expr_lists.len);
+    w.branches = ast_marks(a->branches.len);
+    w.items = ast_marks(a->items.len);
+
+    bool ok = ast_walk_block(&w, body);
+
+    for (u32 k = 0; k <= C_EXPR_LITERAL; k++)
+        free(w.exprs[k]);
+    free(w.expr_lists);
+    free(w.branches);
+    free(w.items);
+    return ok;
+}
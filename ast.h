@@ -10,8 +10,78 @@
 #ifndef _AST_H
 #define _AST_H
 
+#include "expr.h"
 #include "stmt.h"
 
-#include "expr.h"
+// a growable array of nodes of one kind. indices into it never change.
+#define AST_POOL(T)                                                            \
+    struct {                                                                   \
+        T* data;                                                               \
+        u32 len;                                                               \
+        u32 cap;                                                               \
+    }
+
+// a whole tree, or a forest of them. every node lives in one of the pools
+// below, and the lot is freed with ast_free.
+typedef struct Ast {
+    // one pool per C_ExprKind
+    AST_POOL(C_Identifier) idents;
+    AST_POOL(C_UnaryExpr) unaries;
+    AST_POOL(C_BinaryExpr) binaries;
+    AST_POOL(C_ArrayIndex) indexes;
+    AST_POOL(C_FnCall) calls;
+    AST_POOL(C_Assign) assigns;
+    AST_POOL(C_If) ifs;
+    AST_POOL(C_Literal) literals;
+
+    AST_POOL(C_Type) types;
+    AST_POOL(C_ArrayType) array_types;
+    AST_POOL(C_FunctionArgument) fn_args;
+    AST_POOL(C_ExprId) expr_lists; // arguments of calls
+    AST_POOL(C_If_Branch) branches;
+    AST_POOL(C_BlockItem) items;
+    AST_POOL(C_Include) includes; // in the order they are in the file
+    AST_POOL(char) strings; // text of string literals
+} Ast;
+
+Ast ast_new(void);
+void ast_free(Ast* a);
+
+// the node behind expression `id`, which must be from `pool`, like
+// AST_EXPR(a, binaries, id).
+#define AST_EXPR(a, pool, id) (&(a)->pool.data[C_EXPR_INDEX(id)])
+
+// appends `n` nodes to a pool, returning the index of the first one.
+#define ast_push(pool, nodes, n)                                               \
+    ast_push_((void**)&(pool)->data, &(pool)->len, &(pool)->cap,               \
+              sizeof(*(pool)->data), (nodes), (n))
+u32 ast_push_(void** data, u32* len, u32* cap, usize size, const void* nodes,
+              u32 n);
+
+// a pool of any kind, for code that goes over all of them.
+typedef struct {
+    void** data;
+    u32* len;
+    u32* cap;
+    usize size; // of one node
+} AstPoolRef;
+
+#define AST_NPOOLS 16
+
+// every pool of `a`, always in the same order.
+void ast_pools(Ast* a, AstPoolRef res[AST_NPOOLS]);
+
+// copies the text of a string literal into the string pool, with a null
+// terminator, returning its offset.
+u32 ast_add_string(Ast* a, const char* s, u32 len);
+
+// moves every identifier in the tree over to another symbol table, where
+// symbol `i` of the old one is `remap[i]`.
+void ast_remap_syms(Ast* a, const u32* remap);
+
+// whether a tree that did not come from the parser is one it could have made:
+// every id, run of nodes and string is in its pool, every symbol is under
+// `nsyms`, and what `body` reaches is a tree, with no node in it twice.
+bool ast_check(const Ast* a, u32 nsyms, C_Block body);
 
 #endif // _AST_H
@@ -7,11 +7,12 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
+#define _POSIX_C_SOURCE 200809L
+
 #include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h> // used in macro
-#define _POSIX_C_SOURCE 200809L
 
 #include "a_string.h"
 #include "ast_printer.h"
@@ -108,7 +109,7 @@ void ap_visit_array_type(AstPrinter* p, C_ArrayType* t) {
     p->write(p, "array_type(");
     ap_visit_expr(p, t->size);
     p->write(p, ", ");
-    ap_visit_type(p, t->inner);
+    ap_visit_type(p, &p->ast->types.data[t->inner]);
     p->write(p, ")");
 }
 
@@ -118,24 +119,24 @@ void ap_visit_type(AstPrinter* p, C_Type* t) {
             ap_visit_primitive_type(p, t->data.primitive);
         } break;
         case C_TYPE_ARRAY: {
-            ap_visit_array_type(p, t->data.array);
+            ap_visit_array_type(p, &p->ast->array_types.data[t->data.array]);
         } break;
     }
 }
 
 void ap_visit_identifier(AstPrinter* p, C_Identifier* id) {
     p->write(p, "\"");
-    p->write(p, id->ident.data);
+    p->write(p, sym_name(p->syms, id->sym));
     p->write(p, "\"");
 }
 
 void ap_visit_lvalue(AstPrinter* p, C_Lvalue* lv) {
     switch (lv->kind) {
         case C_LV_IDENTIFIER: {
-            ap_visit_identifier(p, lv->data.ident);
+            ap_visit_identifier(p, &p->ast->idents.data[lv->node]);
         } break;
         case C_LV_ARRAY_INDEX: {
-            ap_visit_array_index(p, lv->data.array_index);
+            ap_visit_array_index(p, &p->ast->indexes.data[lv->node]);
         } break;
     }
 }
@@ -157,42 +158,19 @@ void ap_visit_unary(AstPrinter* p, C_UnaryExpr* n) {
     p->write(p, ")");
 }
 
+static const char* BINARY_OP_NAMES[] = {
+    [C_BINARYOP_ADD] = "add", [C_BINARYOP_SUB] = "sub",
+    [C_BINARYOP_MUL] = "mul", [C_BINARYOP_DIV] = "div",
+    [C_BINARYOP_POW] = "pow", [C_BINARYOP_NEQ] = "neq",
+    [C_BINARYOP_GEQ] = "geq", [C_BINARYOP_LEQ] = "leq",
+    [C_BINARYOP_LT] = "lt",   [C_BINARYOP_GT] = "gt",
+    [C_BINARYOP_EQ] = "eq",   [C_BINARYOP_MOD] = "mod",
+    [C_BINARYOP_SHL] = "shl", [C_BINARYOP_SHR] = "shr",
+    [C_BINARYOP_AND] = "and", [C_BINARYOP_OR] = "or",
+};
+
 void ap_visit_binary(AstPrinter* p, C_BinaryExpr* n) {
-    switch (n->op) {
-        case C_BINARYOP_ADD: {
-            p->write(p, "add");
-        } break;
-        case C_BINARYOP_SUB: {
-            p->write(p, "sub");
-        } break;
-        case C_BINARYOP_MUL: {
-            p->write(p, "mul");
-        } break;
-        case C_BINARYOP_DIV: {
-            p->write(p, "div");
-        } break;
-        case C_BINARYOP_POW: {
-            p->write(p, "pow");
-        } break;
-        case C_BINARYOP_NEQ: {
-            p->write(p, "neq");
-        } break;
-        case C_BINARYOP_GEQ: {
-            p->write(p, "geq");
-        } break;
-        case C_BINARYOP_LEQ: {
-            p->write(p, "leq");
-        } break;
-        case C_BINARYOP_LT: {
-            p->write(p, "lt");
-        } break;
-        case C_BINARYOP_GT: {
-            p->write(p, "gt");
-        } break;
-        case C_BINARYOP_EQ: {
-            p->write(p, "eq");
-        } break;
-    }
+    p->write(p, BINARY_OP_NAMES[n->op]);
     p->write(p, "(");
     ap_visit_expr(p, n->lhs);
     p->write(p, ", ");
@@ -210,16 +188,16 @@ void ap_visit_array_index(AstPrinter* p, C_ArrayIndex* n) {
 
 void ap_visit_fn_argument(AstPrinter* p, C_FunctionArgument* arg) {
     p->write(p, "(");
-    ap_visit_identifier(p, arg->ident);
+    ap_visit_identifier(p, &arg->ident);
     p->write(p, ": ");
-    ap_visit_type(p, arg->type);
+    ap_visit_type(p, &p->ast->types.data[arg->type]);
     p->write(p, ")");
 }
 
 void ap_visit_argument_list(AstPrinter* p, C_ArgumentList* lst) {
     p->write(p, "args(");
     for (u32 i = 0; i < lst->args_len; ++i) {
-        ap_visit_fn_argument(p, &lst->args[i]);
+        ap_visit_fn_argument(p, &p->ast->fn_args.data[lst->args + i]);
         if (i != lst->args_len - 1)
             p->write(p, ", ");
     }
@@ -228,15 +206,23 @@ void ap_visit_argument_list(AstPrinter* p, C_ArgumentList* lst) {
 
 void ap_visit_fn_call(AstPrinter* p, C_FnCall* n) {
     p->write(p, "fn_call(");
-    ap_visit_identifier(p, n->ident);
-    p->write(p, ", ");
-    ap_visit_argument_list(p, n->args);
-    p->write(p, ")");
+    ap_visit_identifier(p, &n->ident);
+    p->write(p, ", args(");
+    for (u32 i = 0; i < n->args_len; ++i) {
+        ap_visit_expr(p, p->ast->expr_lists.data[n->args + i]);
+        if (i != n->args_len - 1)
+            p->write(p, ", ");
+    }
+    p->write(p, "))");
 }
 
 void ap_visit_assign(AstPrinter* p, C_Assign* n) {
+    if (n->compound) {
+        p->write(p, BINARY_OP_NAMES[n->op]);
+        p->write(p, "_");
+    }
     p->write(p, "lvalue(");
-    ap_visit_lvalue(p, n->lhs);
+    ap_visit_lvalue(p, &n->lhs);
     p->write(p, ", ");
     ap_visit_expr(p, n->rhs);
     p->write(p, ")");
@@ -256,13 +242,13 @@ void ap_visit_literal(AstPrinter* p, C_Literal* l) {
             } else {
                 // TODO: escape sequences
                 p->writef(p, "\"%.*s\"", (int)l->data.string.len,
-                          l->data.string.data);
+                          &p->ast->strings.data[l->data.string.off]);
             }
         } break;
         case C_CHAR: {
             char ch = l->data._char;
             if (isprint(ch)) {
-                p->writef(p, "'%s'", ch);
+                p->writef(p, "'%c'", ch);
             } else {
                 p->writef(p, "char(%x)", (int)ch);
             }
@@ -283,36 +269,67 @@ void ap_visit_literal(AstPrinter* p, C_Literal* l) {
     }
 }
 
+void ap_visit_block(AstPrinter* p, C_Block* b) {
+    p->write(p, "block(");
+    for (u32 i = 0; i < b->len; ++i) {
+        C_BlockItem* itm = &p->ast->items.data[b->items + i];
+        if (itm->expr != C_EXPR_NONE)
+            ap_visit_expr(p, itm->expr);
+        else
+            p->write(p, "stmt");
+
+        if (i != b->len - 1)
+            p->write(p, ", ");
+    }
+    p->write(p, ")");
+}
+
 void ap_visit_if(AstPrinter* p, C_If* n) {
-    eprintf("not implemented\n");
-    unreachable;
+    p->write(p, "if(");
+    for (u32 i = 0; i < n->branches_len; ++i) {
+        C_If_Branch* b = &p->ast->branches.data[n->branches + i];
+        if (b->kind == C_IF_ELSE) {
+            p->write(p, "else(");
+        } else {
+            p->write(p, "branch(");
+            ap_visit_expr(p, b->cond);
+            p->write(p, ", ");
+        }
+        ap_visit_block(p, &b->block);
+        p->write(p, ")");
+
+        if (i != n->branches_len - 1)
+            p->write(p, ", ");
+    }
+    p->write(p, ")");
 }
 
-void ap_visit_expr(AstPrinter* p, C_Expr* n) {
-    switch (n->kind) {
+void ap_visit_expr(AstPrinter* p, C_ExprId n) {
+    Ast* a = p->ast;
+    switch (C_EXPR_KIND(n)) {
         case C_EXPR_IDENTIFIER: {
-            ap_visit_identifier(p, n->data.ident);
+            ap_visit_identifier(p, AST_EXPR(a, idents, n));
         } break;
         case C_EXPR_UNARYOP: {
-            ap_visit_unary(p, &n->data.unary);
+            ap_visit_unary(p, AST_EXPR(a, unaries, n));
         } break;
         case C_EXPR_BINOP: {
-            ap_visit_binary(p, &n->data.binary);
+            ap_visit_binary(p, AST_EXPR(a, binaries, n));
         } break;
         case C_EXPR_ARRAY_INDEX: {
-            ap_visit_array_index(p, &n->data.array_index);
+            ap_visit_array_index(p, AST_EXPR(a, indexes, n));
         } break;
         case C_EXPR_FNCALL: {
-            ap_visit_fn_call(p, &n->data.fn_call);
+            ap_visit_fn_call(p, AST_EXPR(a, calls, n));
         } break;
         case C_EXPR_ASSIGN: {
-            ap_visit_assign(p, &n->data.assign);
+            ap_visit_assign(p, AST_EXPR(a, assigns, n));
         } break;
         case C_EXPR_IF: {
-            ap_visit_if(p, &n->data._if);
+            ap_visit_if(p, AST_EXPR(a, ifs, n));
         } break;
         case C_EXPR_LITERAL: {
-            ap_visit_literal(p, &n->data.literal);
+            ap_visit_literal(p, AST_EXPR(a, literals, n));
         } break;
     }
 }
@@ -12,6 +12,7 @@
 
 #include "ast.h"
 #include "expr.h"
+#include "symtab.h"
 
 struct AstPrinter;
 
@@ -26,6 +27,9 @@ typedef struct AstPrinter {
     FILE* fp;     // null if file writer is not used
     a_string buf; // for the string writer
     u32 indent;
+
+    const SymbolTable* syms; // for the names of identifiers
+    Ast* ast;                // where the nodes are
 } AstPrinter;
 
 void ap_write_stdout(AstPrinter* p, const char* data);
@@ -56,10 +60,11 @@ void ap_visit_argument_list(AstPrinter* p, C_ArgumentList* lst);
 void ap_visit_fn_call(AstPrinter* p, C_FnCall* n);
 
 void ap_visit_assign(AstPrinter* p, C_Assign* n);
+void ap_visit_block(AstPrinter* p, C_Block* b);
 void ap_visit_if(AstPrinter* p, C_If* n);
 
 void ap_visit_literal(AstPrinter* p, C_Literal* l);
 
-void ap_visit_expr(AstPrinter* p, C_Expr* n);
+void ap_visit_expr(AstPrinter* p, C_ExprId n);
 
 #endif // _AST_PRINTER_H
@@ -10,9 +10,14 @@
 #ifndef _ASTCOMMON_H
 #define _ASTCOMMON_H
 
-#define AST_DECL_FREE(T)    void T##_free(T*)
-#define AST_IMPL_FREE(T, n) void T##_free(T* n)
+#include "common.h"
 
 #define AST_INIT_NODE(T) T res = {.pos = pos}
 
+// an expression in a tree, see expr.h.
+typedef u32 C_ExprId;
+
+// no expression, e.g. the condition of an else branch
+#define C_EXPR_NONE ((C_ExprId)-1)
+
 #endif // _ASTCOMMON_H
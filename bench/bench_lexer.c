@@ -0,0 +1,172 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "common.h"
+#include "lexer.h"
+#include "source.h"
+
+// lexer throughput benchmark.
+//
+// usage: bench_lexer [-n iterations | -t seconds] [-w window] file...
+//
+// every file is lexed into a token stream over and over, either a set number
+// of times or for at least some number of seconds (1 by default). -w lexes the
+// files through a streaming lexer with the given window size instead, without
+// keeping the tokens around.
+//
+// allocations are only counted if BENCH_COUNT_ALLOCS is defined, and malloc,
+// calloc and realloc are wrapped with the linker's --wrap. peak RSS is for the
+// whole process, so run one file at a time to compare them.
+
+#ifdef BENCH_COUNT_ALLOCS
+
+static u64 allocs;
+
+void* __real_malloc(usize size);
+void* __real_calloc(usize n, usize size);
+void* __real_realloc(void* p, usize size);
+
+void* __wrap_malloc(usize size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(usize n, usize size) {
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, usize size) {
+    allocs++;
+    return __real_realloc(p, size);
+}
+
+#endif // BENCH_COUNT_ALLOCS
+
+static f64 now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+// lexes one source to the end on the calling thread, returning the number of
+// tokens.
+static u64 lex_all(const SourceFile* src) {
+    SymbolTable syms = sym_new();
+    Lexer l = lx_new(src->data, src->len, &syms);
+    TokenStream ts = lx_tokenize_jobs(&l, 1);
+    if (l.error.kind != LX_ERROR_NULL)
+        exit(1);
+
+    u64 count = ts.len;
+    ts_free(&ts);
+    lx_free(&l);
+    sym_free(&syms);
+    return count;
+}
+
+static u64 lex_stream(const char* path, usize window) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL)
+        panic("could not open file \"%s\"", path);
+
+    SymbolTable syms = sym_new();
+    Lexer l = lx_new_stream(fp, window, &syms);
+    u64 count = 0;
+
+    Token* t;
+    do {
+        if ((t = lx_next_token(&l)) == NULL) {
+            lx_perror(l.error.kind, "lexer error");
+            exit(1);
+        }
+        count++;
+    } while (t->kind != TOK_EOF);
+
+    lx_free(&l);
+    sym_free(&syms);
+    fclose(fp);
+    return count;
+}
+
+static void usage(void) {
+    eprintf("usage: bench_lexer [-n iterations | -t seconds] [-w window] "
+            "file...\n");
+    exit(1);
+}
+
+i32 main(i32 argc, char* argv[argc]) {
+    u32 iters = 0;
+    f64 min_secs = 1.0;
+    usize window = 0;
+    bool stream = false;
+    i32 first = 1;
+
+    for (; first + 1 < argc && argv[first][0] == '-'; first += 2) {
+        if (!strcmp(argv[first], "-n")) {
+            iters = (u32)atoi(argv[first + 1]);
+        } else if (!strcmp(argv[first], "-t")) {
+            min_secs = atof(argv[first + 1]);
+        } else if (!strcmp(argv[first], "-w")) {
+            window = (usize)atol(argv[first + 1]);
+            stream = true;
+        } else {
+            usage();
+        }
+    }
+
+    if (first >= argc)
+        usage();
+
+    for (i32 i = first; i < argc; i++) {
+        SourceFile src;
+        if (!sf_open(&src, argv[i]))
+            panic("could not read file \"%s\"", argv[i]);
+
+        u64 toks = lex_all(&src); // warm up
+
+#ifdef BENCH_COUNT_ALLOCS
+        u64 allocs_before = allocs;
+#endif
+
+        u32 runs = 0;
+        f64 begin = now(), secs;
+        do {
+            if (stream)
+                lex_stream(argv[i], window);
+            else
+                lex_all(&src);
+            secs = now() - begin;
+        } while (++runs < iters || (iters == 0 && secs < min_secs));
+
+        f64 mb = (f64)src.len * runs / (1024.0 * 1024.0);
+        printf("%s: %lu tokens, %.1f MB/s, %.2fM tokens/s", argv[i],
+               (unsigned long)toks, mb / secs, (f64)toks * runs / secs / 1e6);
+
+#ifdef BENCH_COUNT_ALLOCS
+        printf(", %.4f allocs/token",
+               (f64)(allocs - allocs_before) / ((f64)toks * runs));
+#endif
+
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        printf(", peak RSS %.1f MB\n", (f64)ru.ru_maxrss / 1024.0);
+
+        sf_close(&src);
+    }
+
+    return 0;
+}
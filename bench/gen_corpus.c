@@ -0,0 +1,223 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// generates cimi sources for the lexer benchmark.
+//
+// usage: gen_corpus [-s size] [-m mix] [-r seed]
+//
+// writes at least `size` bytes (1 MiB by default) to stdout. the mix decides
+// what most lines look like:
+//
+//  ident:   long identifiers and keywords
+//  comment: line and block comments, with a bit of code in between
+//  string:  string and character literals, with escapes
+//  number:  integer and float literals
+//  mixed:   all of the above (the default)
+//
+// the output only has to lex, it does not have to make any sense.
+
+typedef enum {
+    MIX_IDENT = 0,
+    MIX_COMMENT,
+    MIX_STRING,
+    MIX_NUMBER,
+    MIX_MIXED,
+} Mix;
+
+static const char* MIX_NAMES[] = {
+    [MIX_IDENT] = "ident",   [MIX_COMMENT] = "comment",
+    [MIX_STRING] = "string", [MIX_NUMBER] = "number",
+    [MIX_MIXED] = "mixed",
+};
+
+static const char* WORDS[] = {
+    "count", "total", "index", "buffer", "result", "value", "node",  "left",
+    "right", "parent", "width", "height", "offset", "length", "item", "acc",
+};
+
+static const char* KEYWORDS[] = {
+    "let", "const", "if", "else", "while", "for", "return", "fn", "and", "or",
+};
+
+static const char* OPS[] = {
+    "+", "-", "*", "/", "%", "==", "!=", "<=", ">=", "<", ">", "<<", ">>",
+};
+
+static const char* ESCAPES[] = {"\\n", "\\t", "\\\"", "\\\\", "\\e"};
+
+static u64 state;
+
+// xorshift64, so a seed always gives the same corpus
+static u32 rnd(u32 n) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (u32)(state % n);
+}
+
+#define PICK(arr) (arr[rnd(sizeof(arr) / sizeof(arr[0]))])
+
+static usize written;
+
+static void put(const char* s) {
+    fputs(s, stdout);
+    written += strlen(s);
+}
+
+static void ident(void) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s_%s%u", PICK(WORDS), PICK(WORDS), rnd(100));
+    put(buf);
+}
+
+static void number(void) {
+    char buf[32];
+    if (rnd(2))
+        snprintf(buf, sizeof(buf), "%u", rnd(1000000));
+    else
+        snprintf(buf, sizeof(buf), "%u.%u", rnd(10000), rnd(100000));
+    put(buf);
+}
+
+static void string(void) {
+    put("\"");
+    for (u32 i = 0, n = 2 + rnd(6); i < n; i++) {
+        put(PICK(WORDS));
+        put(rnd(3) ? " " : PICK(ESCAPES));
+    }
+    put("\"");
+}
+
+static void line_ident(void) {
+    put(PICK(KEYWORDS));
+    put(" ");
+    ident();
+    put(" = ");
+    for (u32 i = 0, n = 2 + rnd(5); i < n; i++) {
+        if (i > 0) {
+            put(" ");
+            put(PICK(OPS));
+            put(" ");
+        }
+        ident();
+    }
+    put("\n");
+}
+
+static void line_comment(void) {
+    if (rnd(3)) {
+        put("// ");
+        for (u32 i = 0, n = 4 + rnd(10); i < n; i++) {
+            put(PICK(WORDS));
+            put(" ");
+        }
+        put("\n");
+    } else {
+        put("/*\n");
+        for (u32 i = 0, n = 1 + rnd(4); i < n; i++) {
+            put(" * ");
+            for (u32 k = 0, m = 4 + rnd(8); k < m; k++) {
+                put(PICK(WORDS));
+                put(" ");
+            }
+            put("\n");
+        }
+        put(" */\n");
+    }
+
+    if (!rnd(4))
+        line_ident();
+}
+
+static void line_string(void) {
+    put("echo ");
+    string();
+    if (rnd(2)) {
+        put(", '");
+        put(rnd(2) ? "x" : PICK(ESCAPES));
+        put("'");
+    }
+    put("\n");
+}
+
+static void line_number(void) {
+    put("let ");
+    ident();
+    put(" = ");
+    for (u32 i = 0, n = 3 + rnd(6); i < n; i++) {
+        if (i > 0) {
+            put(" ");
+            put(PICK(OPS));
+            put(" ");
+        }
+        number();
+    }
+    put("\n");
+}
+
+static void line(Mix m) {
+    switch (m) {
+        case MIX_IDENT: {
+            line_ident();
+        } break;
+        case MIX_COMMENT: {
+            line_comment();
+        } break;
+        case MIX_STRING: {
+            line_string();
+        } break;
+        case MIX_NUMBER: {
+            line_number();
+        } break;
+        case MIX_MIXED: {
+            line(rnd(MIX_MIXED));
+        } break;
+    }
+}
+
+i32 main(i32 argc, char* argv[argc]) {
+    usize size = 1024 * 1024;
+    Mix mix = MIX_MIXED;
+    state = 88172645463325252ULL;
+
+    for (i32 i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-s")) {
+            size = (usize)atol(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-r")) {
+            state ^= (u64)atol(argv[i + 1]) * 0x9E3779B97F4A7C15ULL;
+        } else if (!strcmp(argv[i], "-m")) {
+            usize n = sizeof(MIX_NAMES) / sizeof(MIX_NAMES[0]);
+            usize k = 0;
+            for (; k < n && strcmp(argv[i + 1], MIX_NAMES[k]); k++)
+                ;
+            if (k == n)
+                panic("unknown mix \"%s\"", argv[i + 1]);
+            mix = (Mix)k;
+        } else {
+            eprintf("usage: gen_corpus [-s size] [-m mix] [-r seed]\n");
+            return 1;
+        }
+    }
+
+    if (state == 0)
+        state = 1;
+
+    while (written < size)
+        line(mix);
+
+    return 0;
+}
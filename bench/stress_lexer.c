@@ -0,0 +1,209 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "a_string.h"
+#include "ast.h"
+#include "common.h"
+#include "lexer.h"
+#include "parser.h"
+#include "source.h"
+#include "writer.h"
+
+// lexer stress test.
+//
+// usage: stress_lexer [-j threads] [-n rounds] file...
+//
+// every file is lexed once on its own, then by `threads` threads at once (4 by
+// default), each with a lexer and symbol table of its own, `rounds` times over
+// (2 by default). every token stream has to dump to the same bytes as the one
+// from the first lex, or the test fails.
+//
+// it also parses a file made of nothing but string literals with escapes with
+// a pulling parser, which has to get by with a small buffer of decoded text.
+
+// the most decoded text a pulling parser may keep, in bytes. only the last
+// few tokens can point into it, so it is a few literals long at most.
+#define STRESS_STRINGS_MAX 4096
+#define STRESS_STRINGS_LINES 200000
+
+typedef struct {
+    const SourceFile* srcs;
+    const char** names;
+    char** want; // the binary dump of each file
+    usize* want_len;
+    u32 nfiles;
+    u32 rounds;
+
+    u32 id;
+    u32 failed;
+} StressJob;
+
+// lexes `src` on `jobs` threads and dumps the stream, in the binary format so
+// that every field of every token is compared.
+static char* lex_dump(const SourceFile* src, u32 jobs, usize* len) {
+    SymbolTable syms = sym_new();
+    Lexer l = lx_new(src->data, src->len, &syms);
+    TokenStream ts = lx_tokenize_jobs(&l, jobs);
+
+    char* res;
+    FILE* fp = open_memstream(&res, len);
+    check_alloc(fp);
+    Writer w = wr_new(fp);
+    if (l.error.kind == LX_ERROR_NULL)
+        ts_dump(&ts, src->data, src->len, &w, TS_DUMP_BINARY);
+    else
+        wr_printf(&w, "error %d at %u\n", (int)l.error.kind, l.error.pos.off);
+    wr_free(&w);
+    fclose(fp);
+
+    ts_free(&ts);
+    lx_free(&l);
+    sym_free(&syms);
+    return res;
+}
+
+static void* stress(void* arg) {
+    StressJob* j = arg;
+
+    for (u32 r = 0; r < j->rounds; r++) {
+        for (u32 k = 0; k < j->nfiles; k++) {
+            // each thread starts at a different file, so that they do not all
+            // lex the same one at the same time
+            u32 i = (k + j->id) % j->nfiles;
+
+            // the threads of the lexer itself are tried too, every other round
+            usize len;
+            char* got = lex_dump(&j->srcs[i], 1 + r % 2, &len);
+            if (len != j->want_len[i] || memcmp(got, j->want[i], len) != 0) {
+                eprintf("thread %u, round %u: \"%s\" lexed differently\n",
+                        j->id, r, j->names[i]);
+                j->failed++;
+            }
+            free(got);
+        }
+    }
+
+    return NULL;
+}
+
+// whether the decoded strings of a pulling parser stay bounded on a file with
+// STRESS_STRINGS_LINES lines of escaped string literals.
+static bool pull_strings_bounded(void) {
+    static const char LINE[] = "\"count\\tvalue\\n\" + \"left\\\\right\\\"\"\n";
+    const usize line_len = sizeof(LINE) - 1;
+    a_string src = as_with_capacity(line_len * STRESS_STRINGS_LINES + 1);
+    for (u32 i = 0; i < STRESS_STRINGS_LINES; i++)
+        memcpy(&src.data[i * line_len], LINE, line_len);
+    src.len = line_len * STRESS_STRINGS_LINES;
+    src.data[src.len] = '\0';
+
+    SymbolTable syms = sym_new();
+    Ast ast = ast_new();
+    Parser ps =
+        ps_new_pull(astr("<strings>"), src.data, src.len, &syms, &ast);
+    bool parsed = ps_file(&ps).have;
+    usize cap = ps.lx.strings.cap;
+
+    printf("%u lines of escaped strings: %s, decoded strings buffer %lu "
+           "bytes\n",
+           STRESS_STRINGS_LINES, parsed ? "parsed" : "did not parse",
+           (unsigned long)cap);
+
+    ps_free(&ps);
+    ast_free(&ast);
+    sym_free(&syms);
+    as_free(&src);
+    return parsed && cap <= STRESS_STRINGS_MAX;
+}
+
+static void usage(void) {
+    eprintf("usage: stress_lexer [-j threads] [-n rounds] file...\n");
+    exit(1);
+}
+
+i32 main(i32 argc, char* argv[argc]) {
+    u32 threads = 4;
+    u32 rounds = 2;
+    i32 first = 1;
+
+    for (; first + 1 < argc && argv[first][0] == '-'; first += 2) {
+        if (!strcmp(argv[first], "-j"))
+            threads = (u32)atoi(argv[first + 1]);
+        else if (!strcmp(argv[first], "-n"))
+            rounds = (u32)atoi(argv[first + 1]);
+        else
+            usage();
+    }
+
+    if (first >= argc || threads == 0)
+        usage();
+
+    u32 nfiles = argc - first;
+    SourceFile* srcs = calloc(nfiles, sizeof(SourceFile));
+    char** want = calloc(nfiles, sizeof(char*));
+    usize* want_len = calloc(nfiles, sizeof(usize));
+    check_alloc(srcs);
+    check_alloc(want);
+    check_alloc(want_len);
+
+    for (u32 i = 0; i < nfiles; i++) {
+        if (!sf_open(&srcs[i], argv[first + i]))
+            panic("could not read file \"%s\"", argv[first + i]);
+        want[i] = lex_dump(&srcs[i], 1, &want_len[i]);
+    }
+
+    StressJob* jobs = calloc(threads, sizeof(StressJob));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    check_alloc(jobs);
+    check_alloc(tids);
+
+    for (u32 t = 0; t < threads; t++) {
+        jobs[t] = (StressJob){
+            .srcs = srcs,
+            .names = (const char**)&argv[first],
+            .want = want,
+            .want_len = want_len,
+            .nfiles = nfiles,
+            .rounds = rounds,
+            .id = t,
+        };
+        if (pthread_create(&tids[t], NULL, stress, &jobs[t]) != 0)
+            panic("could not start thread %u", t);
+    }
+
+    u32 failed = 0;
+    for (u32 t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        failed += jobs[t].failed;
+    }
+
+    printf("%u files, %u threads, %u rounds: %u mismatched\n", nfiles, threads,
+           rounds, failed);
+
+    if (!pull_strings_bounded())
+        failed++;
+
+    for (u32 i = 0; i < nfiles; i++) {
+        free(want[i]);
+        sf_close(&srcs[i]);
+    }
+    free(srcs);
+    free(want);
+    free(want_len);
+    free(jobs);
+    free(tids);
+    return failed != 0;
+}
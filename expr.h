@@ -13,34 +13,40 @@
 #include "a_string.h"
 #include "astcommon.h"
 #include "lexertypes.h"
+#include "stmt.h"
 
-// external
-struct C_Stmt;
-struct C_Block;
-
-struct C_ArrayType;
-struct C_Type;
-
-struct C_Literal;
-
-struct C_Identifier;
-struct C_Lvalue;
+// the tree is flat. nodes of each kind are kept one after the other in a pool
+// of their own (see Ast in ast.h), and refer to their children by u32 indices
+// into those pools rather than by pointers. lists of children, like the
+// arguments of a call, are runs of consecutive entries in a pool, given by
+// the index of the first one and a length.
+//
+// the constructors only fill in a node. C_Expr_new_* puts an expression in
+// its pool and hands back its id.
 
-struct C_FunctionArgument;
-struct C_ArgumentList;
-
-struct C_UnaryExpr;
-struct C_BinaryExpr;
-struct C_ArrayIndex;
-struct C_FnCall;
+// external
+struct Ast;
 
-struct C_Assign;
+// an expression is known by a C_ExprId (see astcommon.h): its kind in the top
+// C_EXPR_KIND_BITS, and its index in the pool for that kind in the rest.
+#define C_EXPR_KIND_BITS  4
+#define C_EXPR_KIND_SHIFT (32 - C_EXPR_KIND_BITS)
+#define C_EXPR_INDEX_MAX  ((1u << C_EXPR_KIND_SHIFT) - 1)
 
-struct C_If_Branch;
-struct C_If;
+#define C_EXPR_ID(kind, index) (((u32)(kind) << C_EXPR_KIND_SHIFT) | (index))
+#define C_EXPR_KIND(id)        ((C_ExprKind)((id) >> C_EXPR_KIND_SHIFT))
+#define C_EXPR_INDEX(id)       ((id) & C_EXPR_INDEX_MAX)
 
-union C_ExprData;
-struct C_Expr;
+typedef enum C_ExprKind {
+    C_EXPR_IDENTIFIER = 0,
+    C_EXPR_UNARYOP,
+    C_EXPR_BINOP,
+    C_EXPR_ARRAY_INDEX,
+    C_EXPR_FNCALL,
+    C_EXPR_ASSIGN,
+    C_EXPR_IF,
+    C_EXPR_LITERAL,
+} C_ExprKind;
 
 typedef enum C_PrimitiveType {
     C_INT = 0,
@@ -53,14 +59,12 @@ typedef enum C_PrimitiveType {
 } C_PrimitiveType;
 
 typedef struct C_ArrayType {
-    struct C_Expr* size;
-    struct C_Type* inner;
+    C_ExprId size;
+    u32 inner; // in the type pool
     Pos pos;
 } C_ArrayType;
-AST_DECL_FREE(C_ArrayType);
 
-C_ArrayType C_ArrayType_new(Pos pos, struct C_Expr index, struct C_Type inner);
-void C_ArrayType_free(C_ArrayType* s);
+C_ArrayType C_ArrayType_new(Pos pos, C_ExprId size, u32 inner);
 
 typedef enum {
     C_TYPE_PRIMITIVE = 0,
@@ -72,19 +76,21 @@ typedef struct C_Type {
     Pos pos;
     union {
         enum C_PrimitiveType primitive;
-        struct C_ArrayType* array;
+        u32 array; // in the array type pool
     } data;
 } C_Type;
-AST_DECL_FREE(C_Type);
 
 C_Type C_Type_new_primitive(Pos pos, C_PrimitiveType t);
-C_Type C_Type_new_array(Pos pos, C_ArrayType t);
+C_Type C_Type_new_array(struct Ast* a, Pos pos, C_ArrayType t);
 
 typedef struct C_Literal {
     Pos pos;
     C_PrimitiveType type;
     union {
-        a_string string;
+        struct {
+            u32 off; // into the string pool, null terminated
+            u32 len;
+        } string;
         char _char;
         bool _bool;
         i64 _int;
@@ -93,9 +99,8 @@ typedef struct C_Literal {
     } data;
 } C_Literal;
 
-AST_DECL_FREE(C_Literal);
-
-C_Literal C_Literal_new_string(Pos pos, a_string string);
+// the text must be in the string pool already, see ast_add_string.
+C_Literal C_Literal_new_string(Pos pos, u32 off, u32 len);
 C_Literal C_Literal_new_char(Pos pos, char _char);
 C_Literal C_Literal_new_bool(Pos pos, bool _bool);
 C_Literal C_Literal_new_int(Pos pos, i64 _int);
@@ -103,12 +108,11 @@ C_Literal C_Literal_new_float(Pos pos, f64 _float);
 C_Literal C_Literal_new_null(Pos pos);
 
 typedef struct C_Identifier {
-    a_string ident;
+    u32 sym; // see symtab.h
     Pos pos;
 } C_Identifier;
-AST_DECL_FREE(C_Identifier);
 
-C_Identifier C_Identifier_new(Pos pos, a_string ident);
+C_Identifier C_Identifier_new(Pos pos, u32 sym);
 
 typedef enum {
     C_LV_IDENTIFIER = 0,
@@ -117,16 +121,12 @@ typedef enum {
 
 typedef struct C_Lvalue {
     C__LvalueKind kind;
-    union {
-        struct C_Identifier* ident;
-        struct C_ArrayIndex* array_index;
-    } data;
+    u32 node; // in the identifier or array index pool
     Pos pos;
 } C_Lvalue;
-AST_DECL_FREE(C_Lvalue);
 
-C_Lvalue C_Lvalue_new_ident(Pos pos, struct C_Identifier ident);
-C_Lvalue C_Lvalue_new_array_index(Pos pos, struct C_ArrayIndex array_index);
+// `target` must be an identifier or an array index.
+C_Lvalue C_Lvalue_new(Pos pos, C_ExprId target);
 
 typedef enum C_UnaryOp {
     C_UNARYOP_GROUPING = 0,
@@ -146,77 +146,76 @@ typedef enum C_BinaryOp {
     C_BINARYOP_LT,
     C_BINARYOP_GT,
     C_BINARYOP_EQ,
+    C_BINARYOP_MOD,
+    C_BINARYOP_SHL,
+    C_BINARYOP_SHR,
+    C_BINARYOP_AND,
+    C_BINARYOP_OR,
 } C_BinaryOp;
 
 typedef struct C_FunctionArgument {
-    struct C_Identifier* ident;
-    struct C_Type* type;
+    C_Identifier ident;
+    u32 type; // in the type pool
     Pos pos;
 } C_FunctionArgument;
-AST_DECL_FREE(C_FunctionArgument);
 
 C_FunctionArgument C_FunctionArgument_new(Pos pos, C_Identifier ident,
-                                          C_Type type);
+                                          u32 type);
 
 typedef struct C_ArgumentList {
-    struct C_FunctionArgument* args;
+    u32 args; // the first one in the function argument pool
     u32 args_len;
     Pos pos;
 } C_ArgumentList;
-AST_DECL_FREE(C_ArgumentList);
 
-// args must be allocated
-C_ArgumentList C_ArgumentList_new(Pos pos, C_FunctionArgument* args,
-                                  u32 args_len);
-void C_ArgumentList_free(C_ArgumentList* args);
+C_ArgumentList C_ArgumentList_new(Pos pos, u32 args, u32 args_len);
 
 typedef struct C_UnaryExpr {
-    C_UnaryOp op;
-    struct C_Expr* inner;
+    u8 op; // C_UnaryOp
+    C_ExprId inner;
     Pos pos;
 } C_UnaryExpr;
-AST_DECL_FREE(C_UnaryExpr);
 
-C_UnaryExpr C_UnaryExpr_new(Pos pos, C_UnaryOp op, struct C_Expr inner);
+C_UnaryExpr C_UnaryExpr_new(Pos pos, C_UnaryOp op, C_ExprId inner);
 
 typedef struct C_BinaryExpr {
-    C_BinaryOp op;
-    struct C_Expr* lhs;
-    struct C_Expr* rhs;
+    u8 op; // C_BinaryOp
+    C_ExprId lhs;
+    C_ExprId rhs;
     Pos pos;
 } C_BinaryExpr;
-AST_DECL_FREE(C_BinaryExpr);
 
-C_BinaryExpr C_BinaryExpr_new(Pos pos, C_BinaryOp op, struct C_Expr lhs,
-                              struct C_Expr rhs);
+C_BinaryExpr C_BinaryExpr_new(Pos pos, C_BinaryOp op, C_ExprId lhs,
+                              C_ExprId rhs);
 
 typedef struct C_ArrayIndex {
-    struct C_Expr* ident;
-    struct C_Expr* index;
+    C_ExprId ident;
+    C_ExprId index;
     Pos pos;
 } C_ArrayIndex;
-AST_DECL_FREE(C_ArrayIndex);
 
-C_ArrayIndex C_ArrayIndex_new(Pos pos, struct C_Expr ident,
-                              struct C_Expr index);
+C_ArrayIndex C_ArrayIndex_new(Pos pos, C_ExprId ident, C_ExprId index);
 
 typedef struct C_FnCall {
-    struct C_Identifier* ident;
-    struct C_ArgumentList* args;
+    C_Identifier ident;
+    u32 args; // the first one in the expression list pool
+    u32 args_len;
     Pos pos;
 } C_FnCall;
-AST_DECL_FREE(C_FnCall);
 
-C_FnCall C_FnCall_new(Pos pos, C_Identifier ident, C_ArgumentList args);
+C_FnCall C_FnCall_new(Pos pos, C_Identifier ident, u32 args, u32 args_len);
 
 typedef struct C_Assign {
-    struct C_Lvalue* lhs;
-    struct C_Expr* rhs;
+    C_Lvalue lhs;
+    C_ExprId rhs;
+    bool compound; // lhs op= rhs
+    u8 op;         // C_BinaryOp
     Pos pos;
 } C_Assign;
-AST_DECL_FREE(C_Assign);
 
-C_Assign C_Assign_new(Pos pos, struct C_Lvalue lhs, struct C_Expr rhs);
+C_Assign C_Assign_new(Pos pos, C_Lvalue lhs, C_ExprId rhs);
+C_Assign C_Assign_new_compound(Pos pos, C_BinaryOp op, C_Lvalue lhs,
+                               C_ExprId rhs);
 
 typedef enum C_If_BranchKind {
     C_IF_PRIMARY = 0,
@@ -226,63 +225,31 @@ typedef enum C_If_BranchKind {
 
 typedef struct C_If_Branch {
     enum C_If_BranchKind kind;
-    struct C_Expr* cond;
-    struct C_Block* block;
+    C_ExprId cond; // C_EXPR_NONE for else
+    C_Block block;
     Pos pos;
 } C_If_Branch;
-AST_DECL_FREE(C_If_Branch);
 
-C_If_Branch C_If_Branch_new_primary(Pos pos, struct C_Expr cond,
-                                    struct C_Block block);
-C_If_Branch C_If_Branch_new_elseif(Pos pos, struct C_Expr cond,
-                                   struct C_Block block);
-C_If_Branch C_If_Branch_new_else(Pos pos, struct C_Expr cond,
-                                 struct C_Block block);
+C_If_Branch C_If_Branch_new_primary(Pos pos, C_ExprId cond, C_Block block);
+C_If_Branch C_If_Branch_new_elseif(Pos pos, C_ExprId cond, C_Block block);
+C_If_Branch C_If_Branch_new_else(Pos pos, C_Block block);
 
 typedef struct C_If {
-    struct C_If_Branch* branches;
+    u32 branches; // the first one in the branch pool
     u32 branches_len;
     Pos pos;
 } C_If;
-AST_DECL_FREE(C_If);
-
-C_If C_If_new(Pos pos, struct C_If_Branch* branches, u32 branches_len);
-
-typedef enum C_ExprKind {
-    C_EXPR_IDENTIFIER = 0,
-    C_EXPR_UNARYOP,
-    C_EXPR_BINOP,
-    C_EXPR_ARRAY_INDEX,
-    C_EXPR_FNCALL,
-    C_EXPR_ASSIGN,
-    C_EXPR_IF,
-    C_EXPR_LITERAL,
-} C_ExprKind;
 
-typedef union C_ExprData {
-    struct C_Identifier* ident;
-    struct C_UnaryExpr unary;
-    struct C_BinaryExpr binary;
-    struct C_ArrayIndex array_index;
-    struct C_FnCall fn_call;
-    struct C_Assign assign;
-    struct C_If _if;
-    struct C_Literal literal;
-} C_ExprData;
-
-typedef struct C_Expr {
-    enum C_ExprKind kind;
-    union C_ExprData data;
-} C_Expr;
-AST_DECL_FREE(C_Expr);
-
-C_Expr C_Expr_new_identifier(C_Identifier i);
-C_Expr C_Expr_new_unary(C_UnaryExpr e);
-C_Expr C_Expr_new_binary(C_BinaryExpr e);
-C_Expr C_Expr_new_array_index(C_ArrayIndex e);
-C_Expr C_Expr_new_fncall(C_FnCall e);
-C_Expr C_Expr_new_assign(C_Assign e);
-C_Expr C_Expr_new_if(C_If e);
-C_Expr C_Expr_new_literal(C_Literal e);
+C_If C_If_new(Pos pos, u32 branches, u32 branches_len);
+
+// put a node in its pool. the id is good for as long as the tree is.
+C_ExprId C_Expr_new_identifier(struct Ast* a, C_Identifier e);
+C_ExprId C_Expr_new_unary(struct Ast* a, C_UnaryExpr e);
+C_ExprId C_Expr_new_binary(struct Ast* a, C_BinaryExpr e);
+C_ExprId C_Expr_new_array_index(struct Ast* a, C_ArrayIndex e);
+C_ExprId C_Expr_new_fncall(struct Ast* a, C_FnCall e);
+C_ExprId C_Expr_new_assign(struct Ast* a, C_Assign e);
+C_ExprId C_Expr_new_if(struct Ast* a, C_If e);
+C_ExprId C_Expr_new_literal(struct Ast* a, C_Literal e);
 
 #endif // _EXPR_H
@@ -7,35 +7,37 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
-#include "lexertypes.h"
 #define _POSIX_C_SOURCE 200809L
 
 #include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include "3rdparty/uthash.h"
 #include "a_string.h"
 #include "common.h"
 #include "lexer.h"
+#include "lexertypes.h"
+#include "scan.h"
+#include "unicode.h"
 
 #define CUR  (l->src[l->cur])
 #define PEEK (l->src[l->cur + 1])
-#define BUMP_NEWLINE                                                           \
-    do {                                                                       \
-        l->row++;                                                              \
-        l->bol = ++l->cur;                                                     \
-    } while (0)
-#define IN_BOUNDS (l->cur < l->src_len)
+#define IN_BOUNDS  (l->cur < l->src_len)
+#define END        (l->src + l->src_len)
+#define MORE_INPUT (l->streaming && !l->stream_eof)
 #define POS(sp)                                                                \
     (Pos) {                                                                    \
-        .row = l->row, .col = l->cur - l->bol + 1 - (sp), .span = (sp)         \
+        .off = l->base + l->cur - (sp), .len = (sp)                            \
     }
 
 #define POS_HERE(sp)                                                           \
     (Pos) {                                                                    \
-        .row = l->row, .col = l->cur - l->bol + 1, .span = (sp)                \
+        .off = l->base + l->cur, .len = (sp)                                   \
     }
 
 #define TOKEN(kfull, sp)                                                       \
@@ -43,11 +45,6 @@
         .kind = (kfull), .pos = (POS(sp))                                      \
     }
 
-#define TOK(k, sp)                                                             \
-    (Token) {                                                                  \
-        .kind = TOK_##k, .pos = (POS(sp))                                      \
-    }
-
 #define ERROR(k, sp)                                                           \
     (LexerError) {                                                             \
         .kind = LX_ERROR_##k, .pos = (POS(sp))                                 \
@@ -62,52 +59,222 @@
         }                                                                      \
     } while (0)
 
-#define TRY_AND_FREE(expr)                                                     \
-    do {                                                                       \
-        if ((expr)) {                                                          \
-            goto free_and_done;                                                \
-        } else if (l->error.kind != LX_ERROR_NULL) {                           \
-            as_free(&word);                                                    \
-            return NULL;                                                       \
-        }                                                                      \
-    } while (0)
-
-#define ERROR_BUFSZ 128
-
-static char ERROR_BUF[ERROR_BUFSZ] = {0};
-
-Token token_new_ident(const char* str) {
-    a_string s = astr(str);
+Token token_new_ident(u32 sym) {
     return (Token){
         .kind = TOK_IDENT,
-        .data.string = s,
+        .data.sym = sym,
     };
 }
 
 void token_free(Token* t) {
-    if (t->kind == TOK_IDENT || t->kind == TOK_LITERAL_STRING ||
-        t->kind == TOK_LITERAL_CHAR || t->kind == TOK_LITERAL_NUMBER) {
-        as_free(&t->data.string);
-    }
+    // tokens only borrow from the source buffer.
+    (void)t;
 }
 
 Token token_dupe(Token* t) {
-    Token new = {
-        .kind = t->kind,
-        .pos = t->pos,
-    };
-    if (t->kind == TOK_IDENT || t->kind == TOK_LITERAL_STRING ||
-        t->kind == TOK_LITERAL_CHAR || t->kind == TOK_LITERAL_NUMBER) {
-        new.data.string = as_dupe(&t->data.string);
-    } else if (t->kind == TOK_LITERAL_BOOLEAN) {
-        new.data.boolean = t->data.boolean;
+    return *t;
+}
+
+const char* token_text(const Token* t, const char* src, const char* strings) {
+    u32 off = t->data.span.off;
+    if (off & SPAN_DECODED)
+        return &strings[off & ~SPAN_DECODED];
+    return &src[off];
+}
+
+// what each escape stands for. 0 if it is not one.
+static const char LX_ESCAPE[256] = {
+    ['a'] = '\a', ['b'] = '\b', ['e'] = '\033', ['n'] = '\n', ['r'] = '\r',
+    ['t'] = '\t', ['\\'] = '\\', ['\''] = '\'', ['"'] = '"',
+};
+
+char lx_escape(char ch) {
+    char res = LX_ESCAPE[(u8)ch];
+    return (res != 0) ? res : -1;
+}
+
+// makes room for `len` more bytes in a buffer of decoded strings, which starts
+// out empty and invalid. it grows by doubling, so appending stays cheap.
+static inline void lx_strings_reserve(a_string* b, usize len) {
+    usize need = b->len + len + 1;
+    if (need <= b->cap)
+        return;
+
+    usize cap = (b->cap != 0) ? b->cap : 256;
+    while (cap < need)
+        cap *= 2;
+
+    if (b->data == NULL)
+        *b = as_with_capacity(cap);
+    else
+        as_reserve(b, cap);
+}
+
+static inline void lx_strings_append(a_string* b, const char* s, usize len) {
+    lx_strings_reserve(b, len);
+    memcpy(&b->data[b->len], s, len);
+    b->len += len;
+}
+
+bool token_has_data(TokenKind k) {
+    return token_has_span(k) || k == TOK_IDENT || k == TOK_LITERAL_BOOLEAN ||
+           k == TOK_LITERAL_INT || k == TOK_LITERAL_FLOAT;
+}
+
+bool token_has_span(TokenKind k) {
+    return k == TOK_LITERAL_STRING || k == TOK_LITERAL_CHAR ||
+           k == TOK_LITERAL_NUMBER;
+}
+
+TokenStream ts_new(usize src_len) {
+    TokenStream res = {0};
+    u32 cap = src_len / TS_BYTES_PER_TOKEN + 16;
+    ts_reserve(&res, cap, cap / 2);
+    return res;
+}
+
+// moves an array to new space in the arena, keeping the first `len` elements
+static void* ts_move(Arena* a, void* old, usize len, usize cap, usize size) {
+    void* res = ar_alloc(a, size * cap);
+    if (len != 0)
+        memcpy(res, old, size * len);
+    return res;
+}
+
+void ts_reserve(TokenStream* ts, u32 cap, u32 data_cap) {
+    if (cap <= ts->cap)
+        cap = 0;
+    if (data_cap <= ts->data_cap)
+        data_cap = 0;
+
+    // the first arrays of a stream all go in one block that fits them
+    if (ts->arena.head == NULL) {
+        usize need = (usize)cap * (sizeof(u8) + sizeof(Pos) + sizeof(u32)) +
+                     (usize)data_cap * sizeof(TokenData) + 4 * AR_ALIGN;
+        ts->arena = ar_new((need > AR_BLOCK_SIZE) ? need : AR_BLOCK_SIZE);
+    }
+
+    if (cap != 0) {
+        ts->kinds = ts_move(&ts->arena, ts->kinds, ts->len, cap, sizeof(u8));
+        ts->pos = ts_move(&ts->arena, ts->pos, ts->len, cap, sizeof(Pos));
+        ts->data_idx =
+            ts_move(&ts->arena, ts->data_idx, ts->len, cap, sizeof(u32));
+        ts->cap = cap;
     }
 
-    return new;
+    if (data_cap != 0) {
+        ts->data = ts_move(&ts->arena, ts->data, ts->data_len, data_cap,
+                           sizeof(TokenData));
+        ts->data_cap = data_cap;
+    }
 }
 
-a_string token_kind_to_string(TokenKind k) {
-    char* s;
+void ts_push(TokenStream* ts, const Token* t) {
+    bool has_data = token_has_data(t->kind);
+
+    if (ts->len == ts->cap || (has_data && ts->data_len == ts->data_cap)) {
+        ts_reserve(ts, (ts->len == ts->cap) ? ts->cap * 2 + 16 : ts->cap,
+                   (ts->data_len == ts->data_cap) ? ts->data_cap * 2 + 16
+                                                  : ts->data_cap);
+    }
+
+    u32 i = ts->len++;
+    ts->kinds[i] = t->kind;
+    ts->pos[i] = t->pos;
+    ts->data_idx[i] = ts->data_len;
+    if (has_data)
+        ts->data[ts->data_len++] = t->data;
+}
+
+Token ts_at(const TokenStream* ts, u32 i) {
+    Token res = {.kind = ts->kinds[i], .pos = ts->pos[i]};
+    if (token_has_data(res.kind))
+        res.data = ts->data[ts->data_idx[i]];
+    return res;
+}
+
+void ts_free(TokenStream* ts) {
+    ar_free(&ts->arena);
+    as_free(&ts->strings);
+    *ts = (TokenStream){0};
+}
+
+static void ts_dump_text(const TokenStream* ts, const char* src, usize src_len,
+                         Writer* w) {
+    LineTable lines = lt_new(src, src_len);
+    for (u32 i = 0; i < ts->len; i++) {
+        Token t = ts_at(ts, i);
+        token_write(w, &t, src, ts->strings.data, ts->syms, &lines);
+    }
+    lt_free(&lines);
+}
+
+#define WR_RAW(w, x) wr_write((w), &(x), sizeof(x))
+
+static void ts_dump_binary(const TokenStream* ts, const char* src,
+                           Writer* w) {
+    u32 version = TS_DUMP_VERSION;
+    u32 nsyms = (ts->syms != NULL) ? ts->syms->len : 0;
+    wr_write(w, TS_DUMP_MAGIC, 8);
+    WR_RAW(w, version);
+    WR_RAW(w, ts->len);
+    WR_RAW(w, nsyms);
+
+    for (u32 i = 0; i < nsyms; i++) {
+        u32 len = sym_len(ts->syms, i);
+        WR_RAW(w, len);
+        wr_write(w, sym_name(ts->syms, i), len);
+    }
+
+    for (u32 i = 0; i < ts->len; i++) {
+        Token t = ts_at(ts, i);
+        u8 kind = t.kind;
+        WR_RAW(w, kind);
+        WR_RAW(w, t.pos.off);
+        WR_RAW(w, t.pos.len);
+
+        switch (t.kind) {
+            case TOK_IDENT: {
+                WR_RAW(w, t.data.sym);
+            } break;
+            case TOK_LITERAL_STRING:
+            case TOK_LITERAL_CHAR:
+            case TOK_LITERAL_NUMBER: {
+                WR_RAW(w, t.data.span.len);
+                wr_write(w, token_text(&t, src, ts->strings.data),
+                         t.data.span.len);
+            } break;
+            case TOK_LITERAL_BOOLEAN: {
+                u8 b = t.data.boolean;
+                WR_RAW(w, b);
+            } break;
+            case TOK_LITERAL_INT: {
+                WR_RAW(w, t.data.integer);
+            } break;
+            case TOK_LITERAL_FLOAT: {
+                WR_RAW(w, t.data.floating);
+            } break;
+            default: break;
+        }
+    }
+}
+
+#undef WR_RAW
+
+void ts_dump(const TokenStream* ts, const char* src, usize src_len, Writer* w,
+             TokenDumpFormat fmt) {
+    switch (fmt) {
+        case TS_DUMP_TEXT: {
+            ts_dump_text(ts, src, src_len, w);
+        } break;
+        case TS_DUMP_BINARY: {
+            ts_dump_binary(ts, src, w);
+        } break;
+    }
+}
+
+const char* token_kind_name(TokenKind k) {
+    const char* s = "";
     switch (k) {
         case TOK_IDENT: {
             s = "ident";
@@ -133,6 +300,12 @@ a_string token_kind_to_string(TokenKind k) {
         case TOK_LITERAL_BOOLEAN: {
             s = "literal_boolean";
         } break;
+        case TOK_LITERAL_INT: {
+            s = "literal_int";
+        } break;
+        case TOK_LITERAL_FLOAT: {
+            s = "literal_float";
+        } break;
         case TOK_LET: {
             s = "let";
         } break;
@@ -200,7 +373,7 @@ a_string token_kind_to_string(TokenKind k) {
             s = "continue";
         } break;
         case TOK_REPEAT: {
-            s = "then";
+            s = "repeat";
         } break;
         case TOK_INT: {
             s = "int";
@@ -312,143 +485,379 @@ a_string token_kind_to_string(TokenKind k) {
         } break;
     }
 
-    return astr(s);
+    return s;
 }
 
-void token_print_long(Token* t) {
-    printf("token[%d, %d, %d]: ", t->pos.row, t->pos.col, t->pos.span);
+a_string token_kind_to_string(TokenKind k) {
+    return astr(token_kind_name(k));
+}
+
+// writes decoded text with its escapes put back in, so that a token still
+// takes up one line.
+static void lx_write_escaped(Writer* w, const char* s, u32 len) {
+    static const char ESCAPED[256] = {
+        ['\a'] = 'a', ['\b'] = 'b', ['\033'] = 'e', ['\n'] = 'n',
+        ['\r'] = 'r', ['\t'] = 't', ['\\'] = '\\', ['"'] = '"',
+    };
+
+    for (u32 i = 0; i < len; i++) {
+        char esc = ESCAPED[(u8)s[i]];
+        if (esc) {
+            wr_putc(w, '\\');
+            wr_putc(w, esc);
+        } else {
+            wr_putc(w, s[i]);
+        }
+    }
+}
+
+void token_write(Writer* w, const Token* t, const char* src,
+                 const char* strings, const SymbolTable* syms,
+                 LineTable* lines) {
+    wr_cstr(w, "token[");
+    if (lines != NULL) {
+        LineCol lc = lt_locate(lines, t->pos.off);
+        wr_u32(w, lc.row);
+        wr_cstr(w, ", ");
+        wr_u32(w, lc.col);
+    } else {
+        wr_putc(w, '@');
+        wr_u32(w, t->pos.off);
+    }
+    wr_cstr(w, ", ");
+    wr_u32(w, t->pos.len);
+    wr_cstr(w, "]: ");
 
-    const a_string* s = &t->data.string;
+    u32 len = t->data.span.len;
     switch (t->kind) {
         case TOK_IDENT: {
-            printf("(%.*s)", (int)s->len, s->data);
+            wr_putc(w, '(');
+            wr_write(w, sym_name(syms, t->data.sym), sym_len(syms, t->data.sym));
+            wr_putc(w, ')');
         } break;
         case TOK_LITERAL_STRING: {
-            printf("\"%.*s\"", (int)s->len, s->data);
+            wr_putc(w, '"');
+            if (t->data.span.off & SPAN_DECODED)
+                lx_write_escaped(w, token_text(t, src, strings), len);
+            else
+                wr_write(w, token_text(t, src, strings), len);
+            wr_putc(w, '"');
         } break;
         case TOK_LITERAL_CHAR: {
-            printf("'%.*s'", (int)s->len, s->data);
+            wr_putc(w, '\'');
+            wr_write(w, token_text(t, src, strings), len);
+            wr_putc(w, '\'');
         } break;
         case TOK_LITERAL_NUMBER: {
-            printf("%.*s", (int)s->len, s->data);
+            wr_write(w, token_text(t, src, strings), len);
         } break;
         case TOK_LITERAL_BOOLEAN: {
-            if (t->data.boolean)
-                printf("<true>");
-            else
-                printf("<false>");
+            wr_cstr(w, t->data.boolean ? "<true>" : "<false>");
+        } break;
+        case TOK_LITERAL_INT: {
+            wr_i64(w, t->data.integer);
+        } break;
+        case TOK_LITERAL_FLOAT: {
+            wr_printf(w, "%g", t->data.floating);
+        } break;
+        default: {
+            wr_putc(w, '<');
+            wr_cstr(w, token_kind_name(t->kind));
+            wr_putc(w, '>');
         } break;
-        default: token_print(t);
     }
 
-    putchar('\n');
+    wr_putc(w, '\n');
 }
 
 void token_print(Token* t) {
-    a_string s = token_kind_to_string(t->kind);
-    printf("<%.*s>", (int)s.len, s.data);
-    as_free(&s);
+    printf("<%s>", token_kind_name(t->kind));
 }
 
 // lexer stuff
-#define LX_KWT_STRSZ 64
 
-typedef struct {
-    char txt[LX_KWT_STRSZ];
-    TokenKind kw;
-    UT_hash_handle hh;
-} KeywordTable;
-
-KeywordTable* kwt;
-
-static void lx_kwt_setup(void);
-static void lx_kwt_add(const char* s, TokenKind k);
-static TokenKind lx_kwt_get(const char* s);
-static void lx_kwt_free(void);
-
-static void lx_kwt_setup(void) {
-    kwt = NULL;
-
-    lx_kwt_add("let", TOK_LET);
-    lx_kwt_add("const", TOK_CONST);
-    lx_kwt_add("echo", TOK_ECHO);
-    lx_kwt_add("read", TOK_READ);
-    lx_kwt_add("and", TOK_AND);
-    lx_kwt_add("or", TOK_OR);
-    lx_kwt_add("not", TOK_NOT);
-    lx_kwt_add("if", TOK_IF);
-    lx_kwt_add("else", TOK_ELSE);
-    lx_kwt_add("end", TOK_END);
-    lx_kwt_add("switch", TOK_SWITCH);
-    lx_kwt_add("case", TOK_CASE);
-    lx_kwt_add("default", TOK_DEFAULT);
-    lx_kwt_add("while", TOK_WHILE);
-    lx_kwt_add("for", TOK_FOR);
-    lx_kwt_add("fn", TOK_FN);
-    lx_kwt_add("return", TOK_RETURN);
-    lx_kwt_add("include", TOK_INCLUDE);
-    lx_kwt_add("export", TOK_EXPORT);
-    lx_kwt_add("break", TOK_BREAK);
-    lx_kwt_add("continue", TOK_CONTINUE);
-    lx_kwt_add("repeat", TOK_REPEAT);
-    lx_kwt_add("int", TOK_INT);
-    lx_kwt_add("float", TOK_FLOAT);
-    lx_kwt_add("bool", TOK_BOOL);
-    lx_kwt_add("string", TOK_STRING);
-    lx_kwt_add("char", TOK_CHAR);
-    lx_kwt_add("any", TOK_ANY);
-    lx_kwt_add("null", TOK_NULL);
-}
-
-static void lx_kwt_add(const char* s, TokenKind k) {
-    KeywordTable* row = malloc(sizeof(KeywordTable));
-    check_alloc(row);
-    strncpy(row->txt, s, LX_KWT_STRSZ);
-    row->kw = k;
-    HASH_ADD_STR(kwt, txt, row);
-}
-
-static TokenKind lx_kwt_get(const char* s) {
-    KeywordTable* out;
-    HASH_FIND_STR(kwt, s, out);
-    if (out)
-        return out->kw;
-    else
-        return TOK_INVALID;
+// compares a word against a lowercase keyword of the same length, ignoring
+// case. keywords are all ascii letters, so folding with 0x20 is enough.
+static bool lx__kw_eq(const char* s, const char* kw, u32 len) {
+    for (u32 i = 0; i < len; i++) {
+        if ((s[i] | 0x20) != kw[i])
+            return false;
+    }
+    return true;
 }
 
-static void lx_kwt_free(void) {
-    KeywordTable *elem, *tmp;
-
-    HASH_ITER(hh, kwt, elem, tmp) {
-        HASH_DEL(kwt, elem);
-        free(elem);
+#define KW(str, k)                                                             \
+    if (lx__kw_eq(s, str, len))                                                \
+        return TOK_##k;                                                        \
+    break
+
+// static keyword matcher, dispatching on length and then on the first
+// character, so that a lookup costs at most a couple of compares.
+static TokenKind lx_keyword_get(const char* s, u32 len) {
+    switch (len) {
+        case 2: {
+            switch (s[0] | 0x20) {
+                case 'o': KW("or", OR);
+                case 'i': KW("if", IF);
+                case 'f': KW("fn", FN);
+            }
+        } break;
+        case 3: {
+            switch (s[0] | 0x20) {
+                case 'l': KW("let", LET);
+                case 'n': KW("not", NOT);
+                case 'f': KW("for", FOR);
+                case 'i': KW("int", INT);
+                case 'a': {
+                    if (lx__kw_eq(s, "and", len))
+                        return TOK_AND;
+                    if (lx__kw_eq(s, "any", len))
+                        return TOK_ANY;
+                } break;
+                case 'e': KW("end", END);
+            }
+        } break;
+        case 4: {
+            switch (s[0] | 0x20) {
+                case 'e': {
+                    if (lx__kw_eq(s, "echo", len))
+                        return TOK_ECHO;
+                    if (lx__kw_eq(s, "else", len))
+                        return TOK_ELSE;
+                } break;
+                case 'r': KW("read", READ);
+                case 't': KW("then", THEN);
+                case 'b': KW("bool", BOOL);
+                case 'n': KW("null", NULL);
+                case 'c': {
+                    if (lx__kw_eq(s, "case", len))
+                        return TOK_CASE;
+                    if (lx__kw_eq(s, "char", len))
+                        return TOK_CHAR;
+                } break;
+            }
+        } break;
+        case 5: {
+            switch (s[0] | 0x20) {
+                case 'c': KW("const", CONST);
+                case 'w': KW("while", WHILE);
+                case 'b': KW("break", BREAK);
+                case 'f': KW("float", FLOAT);
+            }
+        } break;
+        case 6: {
+            switch (s[0] | 0x20) {
+                case 's': {
+                    if (lx__kw_eq(s, "switch", len))
+                        return TOK_SWITCH;
+                    if (lx__kw_eq(s, "string", len))
+                        return TOK_STRING;
+                } break;
+                case 'r': {
+                    if (lx__kw_eq(s, "return", len))
+                        return TOK_RETURN;
+                    if (lx__kw_eq(s, "repeat", len))
+                        return TOK_REPEAT;
+                } break;
+                case 'e': KW("export", EXPORT);
+            }
+        } break;
+        case 7: {
+            switch (s[0] | 0x20) {
+                case 'd': KW("default", DEFAULT);
+                case 'i': KW("include", INCLUDE);
+            }
+        } break;
+        case 8: {
+            if (lx__kw_eq(s, "continue", len))
+                return TOK_CONTINUE;
+        } break;
     }
+
+    return TOK_INVALID;
 }
 
+#undef KW
+
 static void lx_trim_spaces(Lexer* l);
 static void lx_trim_comment(Lexer* l);
-static bool lx_is_separator(char ch);
-static bool lx_is_operator_start(char ch);
+static void lx_skip_line_comment(Lexer* l);
+static void lx_skip_block_comment(Lexer* l);
+
+static bool lx_next_symbol(Lexer* l); // true if found
+static bool lx_next_delimited(Lexer* l);
+static bool lx_next_number(Lexer* l);
+static void lx_next_word(Lexer* l, Span* res, u8* shape);
+static bool lx_next_keyword(Lexer* l, Span word);
+static bool lx_next_literal(Lexer* l, Span word);
+static bool lx_next_ident(Lexer* l, Span word, u8 shape);
+
+// character classes, one table lookup per byte instead of a strchr per class.
+enum {
+    CC_SPACE = 1 << 0, // isspace(3), including newlines
+    CC_SEP = 1 << 1,   // separators
+    CC_OP = 1 << 2,    // characters that may start an operator
+    CC_QUOTE = 1 << 3, // string and char delimiters
+    CC_ALPHA = 1 << 4, // letters and underscores
+    CC_DIGIT = 1 << 5,
+    CC_IDENT = 1 << 6, // may appear in an identifier
+    CC_NUM = 1 << 7,   // may appear in a number literal
+};
+
+#define CC_WORD_END (CC_SPACE | CC_SEP | CC_OP | CC_QUOTE)
+
+#define L (CC_ALPHA | CC_IDENT)
+#define D (CC_DIGIT | CC_IDENT | CC_NUM)
+
+static const u8 LX_CLASS[256] = {
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE,
+    ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+
+    ['{'] = CC_SEP, ['}'] = CC_SEP, ['['] = CC_SEP, [']'] = CC_SEP,
+    ['('] = CC_SEP, [')'] = CC_SEP, [';'] = CC_SEP, [':'] = CC_SEP,
+    [','] = CC_SEP,
+
+    ['+'] = CC_OP, ['-'] = CC_OP, ['*'] = CC_OP, ['/'] = CC_OP, ['='] = CC_OP,
+    ['<'] = CC_OP, ['>'] = CC_OP, ['^'] = CC_OP, ['!'] = CC_OP, ['%'] = CC_OP,
+
+    ['"'] = CC_QUOTE, ['\''] = CC_QUOTE,
+
+    ['_'] = L, ['.'] = CC_IDENT | CC_NUM,
+    ['a'] = L, ['b'] = L, ['c'] = L, ['d'] = L, ['e'] = L, ['f'] = L, ['g'] = L,
+    ['h'] = L, ['i'] = L, ['j'] = L, ['k'] = L, ['l'] = L, ['m'] = L, ['n'] = L,
+    ['o'] = L, ['p'] = L, ['q'] = L, ['r'] = L, ['s'] = L, ['t'] = L, ['u'] = L,
+    ['v'] = L, ['w'] = L, ['x'] = L, ['y'] = L, ['z'] = L,
+    ['A'] = L, ['B'] = L, ['C'] = L, ['D'] = L, ['E'] = L, ['F'] = L, ['G'] = L,
+    ['H'] = L, ['I'] = L, ['J'] = L, ['K'] = L, ['L'] = L, ['M'] = L, ['N'] = L,
+    ['O'] = L, ['P'] = L, ['Q'] = L, ['R'] = L, ['S'] = L, ['T'] = L, ['U'] = L,
+    ['V'] = L, ['W'] = L, ['X'] = L, ['Y'] = L, ['Z'] = L,
+    ['0'] = D, ['1'] = D, ['2'] = D, ['3'] = D, ['4'] = D, ['5'] = D, ['6'] = D,
+    ['7'] = D, ['8'] = D, ['9'] = D,
+};
+
+#undef L
+#undef D
+
+// single character symbols
+static const u8 LX_SINGLE[256] = {
+    ['{'] = TOK_LCURLY,   ['}'] = TOK_RCURLY, ['['] = TOK_LBRACKET,
+    [']'] = TOK_RBRACKET, ['('] = TOK_LPAREN, [')'] = TOK_RPAREN,
+    [':'] = TOK_COLON,    [','] = TOK_COMMA,  [';'] = TOK_SEMICOLON,
+    ['<'] = TOK_LT,       ['>'] = TOK_GT,     ['='] = TOK_ASSIGN,
+    ['*'] = TOK_MUL,      ['/'] = TOK_DIV,    ['+'] = TOK_ADD,
+    ['-'] = TOK_SUB,      ['^'] = TOK_CARET,  ['%'] = TOK_PERCENT,
+};
+
+// two character symbols ending in '='
+static const u8 LX_WITH_EQ[256] = {
+    ['='] = TOK_EQ,         ['>'] = TOK_GEQ,        ['<'] = TOK_LEQ,
+    ['!'] = TOK_NEQ,        ['+'] = TOK_ADD_ASSIGN, ['-'] = TOK_SUB_ASSIGN,
+    ['*'] = TOK_MUL_ASSIGN, ['/'] = TOK_DIV_ASSIGN,
+};
+
+// two character symbols made of the same character twice
+static const u8 LX_DOUBLED[256] = {
+    ['>'] = TOK_SHR,
+    ['<'] = TOK_SHL,
+};
+
+Lexer lx_new(const char* src, usize src_len, SymbolTable* syms) {
+    Lexer res = {.src = src, .src_len = src_len, .syms = syms};
+    return res;
+}
 
-static bool lx_next_double_symbol(Lexer* l); // true if found
-static bool lx_next_single_symbol(Lexer* l); // true if found
-static bool lx_next_word(Lexer* l, a_string* res);
-static bool lx_next_keyword(Lexer* l, const a_string* word);
-static bool lx_next_literal(Lexer* l, const a_string* word);
+Lexer lx_new_stream(FILE* fp, usize window, SymbolTable* syms) {
+    Lexer res = lx_new_fd(-1, window, syms);
+    res.fp = fp;
+    return res;
+}
 
-static bool lx_is_separator(char ch) {
-    return strchr("{}[]();:,", ch);
+Lexer lx_new_fd(int fd, usize window, SymbolTable* syms) {
+    if (window == 0)
+        window = LX_STREAM_WINDOW;
+
+    Lexer res = {
+        .streaming = true,
+        .fd = fd,
+        .window = malloc(window),
+        .window_cap = window,
+        .syms = syms,
+    };
+    check_alloc(res.window);
+    res.src = res.window;
+
+    return res;
 }
 
-static bool lx_is_operator_start(char ch) {
-    return strchr("+-*/=<>^!", ch);
+// checks the input that has not been checked yet, so that the rest of the
+// lexer can take it to be valid utf-8. a streaming lexer leaves a character
+// that may be cut off by the end of the window for the next fill.
+static bool lx_check_utf8(Lexer* l) {
+    u32 end = l->src_len;
+    if (MORE_INPUT) {
+        for (u32 k = 1; k <= 3 && k <= end - l->checked; k++) {
+            u8 ch = l->src[end - k];
+            if ((ch & 0xC0) == 0x80)
+                continue;
+            if (ch >= 0xC0)
+                end -= k;
+            break;
+        }
+    }
+
+    const char* bad = sc_utf8_check(&l->src[l->checked], &l->src[end]);
+    if (bad != &l->src[end]) {
+        u32 off = bad - l->src;
+        l->error = (LexerError){
+            .kind = LX_ERROR_INVALID_UTF8,
+            .pos = {.off = l->base + off, .len = 1},
+        };
+        return false;
+    }
+
+    l->checked = end;
+    return true;
 }
 
-Lexer lx_new(const char* src, usize src_len) {
-    lx_kwt_setup();
-    Lexer res = {.src = src, .src_len = src_len, .row = 1};
-    return res;
+// drops everything before the cursor and tops the window back up. if the
+// cursor is already at the start of a full window, the window is grown
+// instead, since a single token does not fit in it.
+static bool lx_stream_fill(Lexer* l) {
+    // whatever has not been checked yet is kept too, even if it was skipped
+    // as part of a comment
+    u32 from = (l->cur < l->checked) ? l->cur : l->checked;
+    usize keep = l->src_len - from;
+    memmove(l->window, &l->src[from], keep);
+    l->base += from;
+    l->cur -= from;
+    l->checked -= from;
+
+    if (keep == l->window_cap) {
+        l->window_cap *= 2;
+        l->window = realloc(l->window, l->window_cap);
+        check_alloc(l->window);
+    }
+
+    usize have = keep;
+    while (!l->stream_eof && have < l->window_cap) {
+        isize got;
+        if (l->fp) {
+            got = fread(&l->window[have], 1, l->window_cap - have, l->fp);
+            if (got == 0 && ferror(l->fp))
+                got = -1;
+        } else {
+            got = read(l->fd, &l->window[have], l->window_cap - have);
+        }
+
+        if (got <= 0)
+            l->stream_eof = true;
+        else
+            have += got;
+    }
+
+    l->src = l->window;
+    l->src_len = have;
+    return lx_check_utf8(l);
 }
 
 static void lx_trim_spaces(Lexer* l) {
@@ -456,8 +865,7 @@ static void lx_trim_spaces(Lexer* l) {
         return;
     }
 
-    while (l->cur < l->src_len && isspace(CUR) && CUR != '\n')
-        l->cur++;
+    l->cur = sc_skip_blanks(&CUR, END) - l->src;
 
     lx_trim_comment(l);
     return;
@@ -471,242 +879,347 @@ static void lx_trim_comment(Lexer* l) {
     if (!strncmp(&CUR, "//", 2)) {
         l->cur += 2; // skip past comment marker
 
-        while (IN_BOUNDS && CUR != '\n')
-            l->cur++;
-
-        lx_trim_spaces(l);
+        lx_skip_line_comment(l);
+        if (l->comment == LX_COMMENT_NONE)
+            lx_trim_spaces(l);
         return;
     }
 
     if (!strncmp(&CUR, "/*", 2)) {
         l->cur += 2; // skip past
 
-        while (IN_BOUNDS && strncmp(&CUR, "*/", 2)) {
-            if (CUR == '\n')
-                BUMP_NEWLINE;
-            else
-                l->cur++;
-        }
-
-        // we found */
-        l->cur += 2;
-
-        lx_trim_spaces(l);
+        lx_skip_block_comment(l);
+        if (l->comment == LX_COMMENT_NONE)
+            lx_trim_spaces(l);
         return;
     }
 }
 
-static bool lx_next_double_symbol(Lexer* l) {
-    if (!lx_is_operator_start(CUR))
-        return false;
+// the skip functions leave `l->comment` set if the window ran out before the
+// comment did, so a streaming lexer can pick it up again after a refill.
 
-    if (l->cur + 2 >= l->src_len) {
-        return false;
+static void lx_skip_line_comment(Lexer* l) {
+    l->cur = sc_find(&CUR, END, '\n') - l->src;
+    l->comment = (!IN_BOUNDS && MORE_INPUT) ? LX_COMMENT_LINE : LX_COMMENT_NONE;
+}
+
+static void lx_skip_block_comment(Lexer* l) {
+    l->comment = LX_COMMENT_NONE;
+
+    while (IN_BOUNDS) {
+        l->cur = sc_find(&CUR, END, '*') - l->src;
+        if (!IN_BOUNDS)
+            break;
+
+        if (l->cur + 1 < l->src_len) {
+            if (PEEK == '/')
+                break;
+            l->cur++;
+        } else if (MORE_INPUT) {
+            // a '*' right at the end of the window, the '/' may follow
+            l->comment = LX_COMMENT_BLOCK;
+            return;
+        } else {
+            l->cur++;
+        }
     }
 
-    if (!strncmp(&CUR, "==", 2)) {
-        l->token = TOK(EQ, 2);
-    } else if (!strncmp(&CUR, ">=", 2)) {
-        l->token = TOK(GEQ, 2);
-    } else if (!strncmp(&CUR, "<=", 2)) {
-        l->token = TOK(LEQ, 2);
-    } else if (!strncmp(&CUR, "!=", 2)) {
-        l->token = TOK(NEQ, 2);
-    } else if (!strncmp(&CUR, ">>", 2)) {
-        l->token = TOK(SHR, 2);
-    } else if (!strncmp(&CUR, "<<", 2)) {
-        l->token = TOK(SHL, 2);
-    } else if (!strncmp(&CUR, "+=", 2)) {
-        l->token = TOK(ADD_ASSIGN, 2);
-    } else if (!strncmp(&CUR, "-=", 2)) {
-        l->token = TOK(SUB_ASSIGN, 2);
-    } else if (!strncmp(&CUR, "*=", 2)) {
-        l->token = TOK(MUL_ASSIGN, 2);
-    } else if (!strncmp(&CUR, "/=", 2)) {
-        l->token = TOK(DIV_ASSIGN, 2);
-    } else {
-        return false;
+    if (!IN_BOUNDS && MORE_INPUT) {
+        l->comment = LX_COMMENT_BLOCK;
+        return;
     }
 
-    l->token.pos = POS_HERE(2);
+    // we found */
     l->cur += 2;
-
-    return true;
 }
 
-static bool lx_next_single_symbol(Lexer* l) {
-    if (!lx_is_separator(CUR) && !lx_is_operator_start(CUR))
-        return false;
-
-    const TokenKind TABLE[] = {
-        ['{'] = TOK_LCURLY,   ['}'] = TOK_RCURLY, ['['] = TOK_LBRACKET,
-        [']'] = TOK_RBRACKET, ['('] = TOK_LPAREN, [')'] = TOK_RPAREN,
-        [':'] = TOK_COLON,    [','] = TOK_COMMA,  [';'] = TOK_SEMICOLON,
-        ['>'] = TOK_LT,       ['<'] = TOK_GT,     ['='] = TOK_EQ,
-        ['*'] = TOK_MUL,      ['/'] = TOK_DIV,    ['+'] = TOK_ADD,
-        ['-'] = TOK_SUB,      ['^'] = TOK_CARET,  ['%'] = TOK_PERCENT,
-    };
+static bool lx_next_symbol(Lexer* l) {
+    u8 ch = CUR;
+    TokenKind k;
+
+    if (l->cur + 1 < l->src_len) {
+        u8 next = PEEK;
+        if ((next == '=' && (k = LX_WITH_EQ[ch])) ||
+            (next == ch && (k = LX_DOUBLED[ch]))) {
+            l->token = (Token){
+                .kind = k,
+                .pos = POS_HERE(2),
+            };
+            l->cur += 2;
+            return true;
+        }
+    }
 
-    TokenKind t;
-    if ((t = TABLE[(int)CUR]) == 0)
+    if ((k = LX_SINGLE[ch]) == 0)
         return false;
 
     l->token = (Token){
-        .kind = t,
+        .kind = k,
         .pos = POS_HERE(1),
     };
-
     l->cur++;
 
     return true;
 }
 
-static bool lx_next_word(Lexer* l, a_string* res) {
-    const char* begin = &CUR;
-    u32 len = 0;
-    const char DELIMS[] = "\"'";
-    bool delimited_literal = strchr(DELIMS, *begin);
-    char delim = 0;
-    if (delimited_literal) {
-        delim = CUR;
-        l->cur++;
-        len++;
-    }
-
-    do {
-        bool stop;
+static bool lx_next_delimited(Lexer* l) {
+    u32 off = l->cur;
+    char delim = CUR;
+    l->cur++;
 
-        if (!IN_BOUNDS)
+    // jump from one quote or backslash to the next, skipping over whatever is
+    // escaped. string literals are decoded on the way, but only once the first
+    // backslash turns up: until then, the source itself is the decoded text.
+    // character literals are left to the parser.
+    bool decode = delim == '"';
+    u32 mark = l->strings.len;
+    u32 run = l->cur; // start of the source not copied out yet
+    bool escaped = false;
+
+    while (IN_BOUNDS) {
+        l->cur = sc_find2(&CUR, END, delim, '\\') - l->src;
+        if (!IN_BOUNDS || CUR == delim)
             break;
 
-        if (delimited_literal)
-            stop = CUR == delim;
-        else
-            stop = lx_is_operator_start(CUR) || lx_is_separator(CUR) ||
-                   isspace(CUR) || strchr(DELIMS, CUR);
-
-        if (CUR == '\\') {
-            len++;
-            l->cur++;
+        if (decode && l->cur + 1 < l->src_len) {
+            char ch = LX_ESCAPE[(u8)PEEK];
+            if (ch == 0) {
+                l->strings.len = mark;
+                l->error = (LexerError){
+                    .kind = LX_ERROR_BAD_ESCAPE,
+                    .pos = POS_HERE(2),
+                };
+                return false;
+            }
+
+            // the run up to the backslash, then what it stands for
+            a_string* b = &l->strings;
+            lx_strings_reserve(b, l->cur - run + 1);
+            memcpy(&b->data[b->len], &l->src[run], l->cur - run);
+            b->len += l->cur - run;
+            b->data[b->len++] = ch;
+            run = l->cur + 2;
+            escaped = true;
         }
 
-        if (stop)
-            break;
-
-        len++;
-        l->cur++;
-    } while (1);
+        l->cur += 2;
+    }
 
-    if (delimited_literal) {
-        if (!IN_BOUNDS) {
-            l->error = ERROR(EOF, 1);
-            return false;
-        }
+    if (!IN_BOUNDS) {
+        l->strings.len = mark;
+        l->error = ERROR(EOF, 1);
+        return false;
+    }
 
-        if (CUR != delim) {
-            if (strchr(DELIMS, CUR) != NULL)
-                l->error = ERROR(MISMATCHED_DELIMITER, len);
-            else
-                l->error = ERROR(UNTERMINATED_LITERAL, len);
-            return false;
-        } else {
-            l->cur++;
-            len++;
-        }
+    // strip the delimiters off
+    Span text = {.off = off + 1, .len = l->cur - off - 1};
+    if (escaped) {
+        lx_strings_append(&l->strings, &l->src[run], l->cur - run);
+        text = (Span){.off = mark | SPAN_DECODED, .len = l->strings.len - mark};
     }
 
-    *res = as_new();
-    as_ncopy_cstr(res, begin, len);
+    l->cur++;
+    l->token = (Token){
+        .kind = (delim == '\'') ? TOK_LITERAL_CHAR : TOK_LITERAL_STRING,
+        .pos = POS(l->cur - off),
+        .data.span = text,
+    };
 
     return true;
 }
 
-static bool lx_next_keyword(Lexer* l, const a_string* word) {
-    if (word->len >= LX_KWT_STRSZ)
-        return false;
-
-    TokenKind kw;
-    a_string word_lower = as_tolower(word);
-    if ((kw = lx_kwt_get(word_lower.data)) != TOK_INVALID) {
-        l->token = TOKEN(kw, word_lower.len);
-        as_free(&word_lower);
-        return true;
+// powers of ten that are exact as doubles
+static const f64 LX_POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// the slow way, for floats with too many digits to be done exactly by hand.
+static bool lx_strtod(const char* s, u32 len, f64* res) {
+    char buf[64];
+    a_string big = {0};
+    char* p = buf;
+
+    if (len < sizeof(buf)) {
+        memcpy(buf, s, len);
+        buf[len] = '\0';
     } else {
-        as_free(&word_lower);
-        return false;
+        big = as_slice_cstr(s, 0, len);
+        p = big.data;
     }
-}
 
-static bool lx__is_number(const a_string* word) {
-    // edge case: single decimal
-    if (as_first(word) == '.' && word->len == 1)
-        return false;
+    errno = 0;
+    *res = strtod(p, NULL);
+    bool ok = errno != ERANGE;
 
-    bool found_decimal = false;
-    for (usize i = 0; i < word->len; i++) {
-        char cur = as_at(word, i);
+    as_free(&big);
+    return ok;
+}
 
-        if (isdigit(cur))
-            continue;
+// like strtoll with a base of 0, a leading zero makes an int octal.
+static bool lx_octal(const char* s, u32 len, i64* res) {
+    u64 val = 0;
+    for (u32 i = 1; i < len; i++) {
+        if (s[i] > '7' || val > (u64)INT64_MAX >> 3)
+            return false;
+        val = val << 3 | (u64)(s[i] - '0');
+    }
 
-        if (cur == '.') {
-            if (found_decimal)
-                return false;
-            else
-                found_decimal = true;
+    *res = (i64)val;
+    return true;
+}
 
-            continue;
+// lexes a number literal, working out its value as it goes. returns false,
+// without moving, if the word is not a number after all, so lx_next_word can
+// deal with it.
+//
+// floats with up to 15 significant digits and 22 decimal places are exact as
+// the quotient of two doubles, which covers nearly all of them. a literal that
+// is out of range (or not valid octal) stays a TOK_LITERAL_NUMBER with its
+// text, so the parser can complain about it.
+static bool lx_next_number(Lexer* l) {
+    u32 off = l->cur;
+    u64 mant = 0;
+    u32 digits = 0; // significant ones
+    u32 frac = 0;   // after the decimal point
+    bool dot = false, overflow = false;
+
+    while (IN_BOUNDS) {
+        u8 ch = CUR;
+        if (ch >= '0' && ch <= '9') {
+            if (mant > (UINT64_MAX - 9) / 10)
+                overflow = true;
+            else
+                mant = mant * 10 + (ch - '0');
+            digits += mant != 0;
+            frac += dot;
+        } else if (ch == '.' && !dot) {
+            dot = true;
+        } else {
+            break;
         }
+        l->cur++;
+    }
 
+    u32 len = l->cur - off;
+    if ((IN_BOUNDS && !(LX_CLASS[(u8)CUR] & CC_WORD_END)) ||
+        (dot && len == 1)) {
+        l->cur = off;
         return false;
     }
 
+    const char* s = &l->src[off];
+    l->token = (Token){.pos = POS(len)};
+
+    bool ok;
+    if (dot) {
+        l->token.kind = TOK_LITERAL_FLOAT;
+        if ((ok = !overflow && digits <= 15 && frac <= 22))
+            l->token.data.floating = (f64)mant / LX_POW10[frac];
+        else
+            ok = lx_strtod(s, len, &l->token.data.floating);
+    } else {
+        l->token.kind = TOK_LITERAL_INT;
+        if (s[0] == '0' && len > 1)
+            ok = lx_octal(s, len, &l->token.data.integer);
+        else if ((ok = !overflow && mant <= INT64_MAX))
+            l->token.data.integer = (i64)mant;
+    }
+
+    if (!ok) {
+        l->token.kind = TOK_LITERAL_NUMBER;
+        l->token.data.span = (Span){.off = off, .len = len};
+    }
+
     return true;
 }
 
-static bool lx_next_literal(Lexer* l, const a_string* word) {
-    char* p;
-    if ((p = strchr("\"'", as_first(word)))) {
-        if (word->len == 1)
-            unreachable;
+// classes of a character outside of ascii. the input has been checked by
+// then, so it can be decoded without looking out for anything, as long as all
+// of it is there.
+static u8 lx_unicode_class(Lexer* l, u32* len) {
+    u8 lead = CUR;
+    *len = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : 2;
+    if (l->cur + *len > l->src_len)
+        return 0;
+
+    u32 cp = uc_decode(&CUR, len);
+    if (uc_is_ident_start(cp))
+        return CC_ALPHA | CC_IDENT;
+    else if (uc_is_ident_continue(cp))
+        return CC_IDENT;
+    else
+        return 0;
+}
 
-        a_string res = as_slice(word, 1, word->len - 1);
-        TokenKind k = (*p == '\'') ? TOK_LITERAL_CHAR : TOK_LITERAL_STRING;
+// scans a bare word. `shape` is set to the classes shared by every character
+// in it, so an identifier can be told apart without looking at it again.
+// numbers never get this far.
+static void lx_next_word(Lexer* l, Span* res, u8* shape) {
+    u32 off = l->cur;
+    u8 all = CC_IDENT;
+    u8 first = 0;
+
+    while (IN_BOUNDS) {
+        u8 cls = LX_CLASS[(u8)CUR];
+        u32 len = 1;
+        if (cls & CC_WORD_END)
+            break;
 
-        l->token = (Token){
-            .kind = k,
-            .pos = POS(word->len),
-            .data.string = res,
-        };
-        return true;
+        if ((u8)CUR >= 0x80) {
+            // in a window, the rest of the character may not be there yet.
+            // the token is lexed again once it is.
+            cls = lx_unicode_class(l, &len);
+            if (l->cur + len > l->src_len)
+                break;
+        } else if (CUR == '\\') {
+            // an escaped character is never valid in a word
+            l->cur++;
+            cls = 0;
+        }
+
+        if (l->cur == off)
+            first = cls;
+        all &= cls;
+        l->cur += len;
     }
 
-    if (lx__is_number(word)) {
-        a_string new = as_dupe(word);
-        if (!as_valid(&new))
-            panic("failed to dupe a_string for number");
+    u32 len = l->cur - off;
 
-        l->token = (Token){
-            .kind = TOK_LITERAL_NUMBER,
-            .pos = POS(word->len),
-            .data.string = new,
-        };
+    // the first character of an identifier must be a letter
+    if (len == 0 || !(first & CC_ALPHA))
+        all &= ~CC_IDENT;
+
+    *res = (Span){.off = off, .len = len};
+    *shape = all;
+}
+
+static bool lx_next_keyword(Lexer* l, Span word) {
+    TokenKind kw;
+    if ((kw = lx_keyword_get(&l->src[word.off], word.len)) != TOK_INVALID) {
+        l->token = TOKEN(kw, word.len);
         return true;
+    } else {
+        return false;
     }
+}
 
-    if (as_equal_cstr(word, "true")) {
+static bool lx_next_literal(Lexer* l, Span word) {
+    const char* w = &l->src[word.off];
+
+    if (word.len == 4 && !strncmp(w, "true", 4)) {
         l->token = (Token){
             .kind = TOK_LITERAL_BOOLEAN,
-            .pos = POS(word->len),
+            .pos = POS(word.len),
             .data.boolean = true,
         };
         return true;
     }
 
-    if (as_equal_cstr(word, "false")) {
+    if (word.len == 5 && !strncmp(w, "false", 5)) {
         l->token = (Token){
             .kind = TOK_LITERAL_BOOLEAN,
-            .pos = POS(word->len),
+            .pos = POS(word.len),
             .data.boolean = false,
         };
         return true;
@@ -715,103 +1228,621 @@ static bool lx_next_literal(Lexer* l, const a_string* word) {
     return false;
 }
 
-static bool lx__is_ident(const a_string* s) {
-    char first = as_first(s);
-    if (!isalpha(first) && first != '_')
-        return false;
-
-    for (size_t i = 0; i < s->len; i++) {
-        char ch = as_at(s, i);
-        if (!isalnum(ch) && !strchr("_.", ch))
-            return false;
-    }
-
-    return true;
-}
-
-static bool lx_next_ident(Lexer* l, const a_string* word) {
-    if (lx__is_ident(word)) {
-        a_string new = as_dupe(word);
-        if (!as_valid(&new))
-            panic("failed to dupe a_string for ident");
-
+static bool lx_next_ident(Lexer* l, Span word, u8 shape) {
+    if (shape & CC_IDENT) {
         l->token = (Token){
             .kind = TOK_IDENT,
-            .data.string = new,
-            .pos = POS(new.len),
+            .data.sym = sym_intern(l->syms, &l->src[word.off], word.len),
+            .pos = POS(word.len),
         };
         return true;
     } else {
-        l->error = ERROR(INVALID_IDENTIFIER, word->len);
+        l->error = ERROR(INVALID_IDENTIFIER, word.len);
         return false;
     }
 }
 
-Token* lx_next_token(Lexer* l) {
-    if (l->error.kind != LX_ERROR_NULL) {
-        token_free(&l->token);
-    }
-
-    l->token = (Token){0};
-    l->error = (LexerError){0};
-
-    lx_trim_spaces(l);
+// lexes the token at the cursor, with blanks and comments already skipped.
+static Token* lx_lex_token(Lexer* l) {
     if (l->cur >= l->src_len) {
-        l->token = TOK(EOF, 1);
+        l->token = (Token){.kind = TOK_EOF, .pos = POS_HERE(0)};
         goto done;
     }
 
     if (CUR == '\n') {
-        l->token = TOK(NEWLINE, 1);
-        BUMP_NEWLINE;
+        l->token = (Token){.kind = TOK_NEWLINE, .pos = POS_HERE(1)};
+        l->cur++;
         goto done;
     }
 
-    TRY(lx_next_double_symbol(l));
-    TRY(lx_next_single_symbol(l));
+    u8 cls = LX_CLASS[(u8)CUR];
+    if (cls & (CC_SEP | CC_OP))
+        TRY(lx_next_symbol(l));
 
-    a_string word = {0};
-    if (!lx_next_word(l, &word)) // error
+    if (cls & CC_QUOTE) {
+        TRY(lx_next_delimited(l));
         return NULL;
+    }
+
+    if (cls & CC_NUM)
+        TRY(lx_next_number(l));
+
+    Span word = {0};
+    u8 shape = 0;
+    lx_next_word(l, &word, &shape);
+
+    if (word.len == 0) {
+        l->error = ERROR(INVALID_IDENTIFIER, 0);
+        return NULL;
+    }
 
-    TRY_AND_FREE(lx_next_keyword(l, &word));
-    TRY_AND_FREE(lx_next_literal(l, &word));
-    TRY_AND_FREE(lx_next_ident(l, &word));
+    if (shape & CC_IDENT)
+        TRY(lx_next_keyword(l, word));
+    TRY(lx_next_literal(l, word));
+    TRY(lx_next_ident(l, word, shape));
 
-free_and_done:
-    as_free(&word);
 done:
     return &l->token;
 }
 
-Tokens lx_tokenize(Lexer* l) {
-    Tokens toks = {0};
+// a token is only trusted if at least this many bytes follow it in the window
+// (or the input has ended), which covers every bit of lookahead the lexer does,
+// and the longest utf-8 character.
+#define LX_LOOKAHEAD 4
+
+// the window is only refilled when the lexer gets close to its end. the
+// previous token is dead by then, so everything before the cursor can go.
+static Token* lx_next_token_stream(Lexer* l) {
+    for (;;) {
+        if (l->comment == LX_COMMENT_LINE)
+            lx_skip_line_comment(l);
+        else if (l->comment == LX_COMMENT_BLOCK)
+            lx_skip_block_comment(l);
+
+        if (l->comment == LX_COMMENT_NONE)
+            lx_trim_spaces(l);
+
+        if (l->comment == LX_COMMENT_NONE &&
+            (!MORE_INPUT || l->cur + LX_LOOKAHEAD <= l->src_len))
+            break;
+
+        if (!lx_stream_fill(l))
+            return NULL;
+    }
+
+    // if the token runs up against the end of the window, it may continue in
+    // the next chunk: rewind, move it to the front and lex it again.
+    for (;;) {
+        u32 cur = l->cur;
+
+        l->strings.len = 0;
+        Token* t = lx_lex_token(l);
+        if (!MORE_INPUT || l->cur + LX_LOOKAHEAD <= l->src_len)
+            return t;
+
+        l->cur = cur;
+        l->token = (Token){0};
+        l->error = (LexerError){0};
+        if (!lx_stream_fill(l))
+            return NULL;
+    }
+}
+
+// build with -DLX_TRACE to have every token written to stderr as it is lexed.
+// otherwise the hook is not there at all.
+#ifdef LX_TRACE
+static void lx_trace(Lexer* l, Token* t) {
+    // on the stack, so that lexers on other threads can trace too
+    char buf[512];
+    Writer w = {.fp = stderr, .buf = buf, .cap = sizeof(buf)};
+    wr_cstr(&w, "trace: ");
+    if (t != NULL)
+        token_write(&w, t, l->src, l->strings.data, l->syms, NULL);
+    else
+        wr_printf(&w, "%s\n", lx_strerror(l->error.kind));
+    wr_flush(&w);
+}
+#define LX_TRACE_TOKEN(l, t) lx_trace(l, t)
+#else
+#define LX_TRACE_TOKEN(l, t) ((void)0)
+#endif
+
+Token* lx_next_token(Lexer* l) {
+    if (l->error.kind != LX_ERROR_NULL) {
+        token_free(&l->token);
+    }
+
+    l->token = (Token){0};
+    l->error = (LexerError){0};
+
+    Token* t;
+    if (l->streaming) {
+        t = lx_next_token_stream(l);
+    } else if (l->checked < l->src_len && !lx_check_utf8(l)) {
+        t = NULL;
+    } else {
+        lx_trim_spaces(l);
+        t = lx_lex_token(l);
+    }
+
+    LX_TRACE_TOKEN(l, t);
+    return t;
+}
+
+static TokenStream lx_tokenize_serial(Lexer* l) {
+    TokenStream toks = ts_new(l->src_len - l->cur);
     Token* tok = {0};
     do {
         tok = lx_next_token(l);
 
         if (!tok) {
             lx_perror(l->error.kind, "\033[31;1mlexer error\033[0m");
-            av_clear(&toks);
+            toks.len = toks.data_len = 0;
+            as_free(&l->strings);
             goto end;
-        } else {
-            token_print_long(tok);
         }
 
-        av_append(&toks, *tok);
+        ts_push(&toks, tok);
     } while (!tok || tok->kind != TOK_EOF);
 
 end:
+    toks.strings = l->strings;
+    toks.syms = l->syms;
+    l->strings = (a_string){0};
     return toks;
 }
 
+// inputs smaller than this are always lexed on the calling thread.
+#ifndef LX_PARALLEL_MIN
+#define LX_PARALLEL_MIN (1024 * 1024)
+#endif
+
+// chunks are never made smaller than this.
+#ifndef LX_CHUNK_MIN
+#define LX_CHUNK_MIN (128 * 1024)
+#endif
+
+// more chunks than threads, so one slow chunk does not hold up the rest.
+#define LX_CHUNKS_PER_JOB 4
+
+typedef struct {
+    u32 off;
+    u32 len;
+
+    // results
+    Tokens toks;
+    SymbolTable syms; // the chunk's own, merged into the lexer's afterwards
+    u32* remap;       // chunk symbol id -> lexer symbol id
+    Lexer lx;         // the lexer where it stopped, error included
+    u32 at;           // index of the first token in the stitched stream
+    u32 data_at;      // and of its first bit of token data
+    u32 strings_at;   // and of its decoded strings
+} LexerChunk;
+
+typedef struct LexerJobs {
+    const char* src;
+    LexerChunk* chunks;
+    u32 nchunks;
+    TokenStream* dest; // the stitched stream
+
+    // each thread picks up chunks one at a time, until there are none left
+    void (*work)(struct LexerJobs* j, u32 i);
+    u32 next;
+    pthread_mutex_t lock;
+} LexerJobs;
+
+// bytes the split scan has to stop at. everything else is skipped over.
+static const bool LX_SPLIT_STOP[256] = {
+    ['\n'] = true, ['\\'] = true, ['"'] = true, ['\''] = true, ['/'] = true,
+};
+
+// cuts the source up into at most `want` chunks of roughly equal size. a chunk
+// may only end right after a newline the lexer would make a newline token out
+// of, so literals and comments are followed along the way.
+static u32 lx_split(const char* src, u32 len, u32 want, LexerChunk* chunks) {
+    const char* end = src + len;
+    u32 step = len / want;
+    u32 n = 0, start = 0;
+    u32 i = 0;
+
+    while (i < len) {
+        switch (src[i]) {
+            case '\n': {
+                i++;
+
+                if (i - start >= step && n + 1 < want && i < len) {
+                    chunks[n++] = (LexerChunk){.off = start, .len = i - start};
+                    start = i;
+                }
+            } break;
+            case '\\': {
+                // lx_next_word lets a backslash escape anything, newlines too
+                i += 2;
+            } break;
+            case '"':
+            case '\'': {
+                char delim = src[i++];
+                while (i < len) {
+                    i = sc_find2(&src[i], end, delim, '\\') - src;
+                    if (i >= len || src[i] == delim)
+                        break;
+                    i += 2;
+                }
+                i++;
+            } break;
+            case '/': {
+                if (i + 1 < len && src[i + 1] == '/') {
+                    i = sc_find(&src[i], end, '\n') - src;
+                } else if (i + 1 < len && src[i + 1] == '*') {
+                    for (i += 2; i < len; i++) {
+                        i = sc_find(&src[i], end, '*') - src;
+                        if (i >= len || (i + 1 < len && src[i + 1] == '/'))
+                            break;
+                    }
+                    i += 2;
+                } else {
+                    i++;
+                }
+            } break;
+            default: {
+                while (i < len && !LX_SPLIT_STOP[(u8)src[i]])
+                    i++;
+            } break;
+        }
+    }
+
+    chunks[n++] = (LexerChunk){.off = start, .len = len - start};
+    return n;
+}
+
+// lexes a chunk as if the lexer had just got to it. only the last chunk keeps
+// its EOF token.
+static void lx_lex_chunk(LexerJobs* j, u32 i) {
+    LexerChunk* c = &j->chunks[i];
+    Lexer l = lx_new(j->src, c->off + c->len, &c->syms);
+    l.cur = l.checked = c->off;
+
+    u32 cap = c->len / TS_BYTES_PER_TOKEN + 16;
+    av_reserve(&c->toks, cap);
+
+    Token* t;
+    while ((t = lx_next_token(&l)) != NULL) {
+        if (t->kind == TOK_EOF && i != j->nchunks - 1)
+            break;
+        av_append(&c->toks, *t);
+        if (t->kind == TOK_EOF)
+            break;
+    }
+
+    c->lx = l;
+}
+
+static void lx_copy_chunk(LexerJobs* j, u32 i) {
+    LexerChunk* c = &j->chunks[i];
+    TokenStream* ts = j->dest;
+
+    u32 d = c->data_at;
+    for (u32 k = 0; k < c->toks.len; k++) {
+        const Token* t = &c->toks.data[k];
+        u32 at = c->at + k;
+
+        ts->kinds[at] = t->kind;
+        ts->pos[at] = t->pos;
+        ts->data_idx[at] = d;
+        if (!token_has_data(t->kind))
+            continue;
+
+        ts->data[d] = t->data;
+        if (t->kind == TOK_IDENT)
+            ts->data[d].sym = c->remap[t->data.sym];
+        else if (token_has_span(t->kind) && (t->data.span.off & SPAN_DECODED))
+            ts->data[d].span.off += c->strings_at;
+        d++;
+    }
+
+    if (c->lx.strings.len != 0)
+        memcpy(&ts->strings.data[c->strings_at], c->lx.strings.data,
+               c->lx.strings.len);
+
+    av_free(&c->toks);
+    as_free(&c->lx.strings);
+}
+
+static void* lx_worker(void* arg) {
+    LexerJobs* j = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&j->lock);
+        u32 i = j->next++;
+        pthread_mutex_unlock(&j->lock);
+
+        if (i >= j->nchunks)
+            break;
+
+        j->work(j, i);
+    }
+
+    return NULL;
+}
+
+// runs `work` over every chunk on up to `jobs` threads, the calling one
+// included. if a thread cannot be started, the others pick up its share.
+static void lx_run_jobs(LexerJobs* j, u32 jobs,
+                        void (*work)(LexerJobs* j, u32 i)) {
+    j->work = work;
+    j->next = 0;
+
+    if (jobs > j->nchunks)
+        jobs = j->nchunks;
+
+    pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+    check_alloc(threads);
+
+    u32 started = 0;
+    for (; started + 1 < jobs; started++) {
+        if (pthread_create(&threads[started], NULL, lx_worker, j) != 0)
+            break;
+    }
+    lx_worker(j);
+    for (u32 i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+}
+
+static u32 lx_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n < 1) ? 1 : (u32)n;
+}
+
+TokenStream lx_tokenize_jobs(Lexer* l, u32 jobs) {
+    if (jobs == 0)
+        jobs = lx_cpu_count();
+
+    // only a fresh in-memory lexer can be split up
+    if (l->streaming || l->cur != 0 || jobs < 2 ||
+        l->src_len < LX_PARALLEL_MIN || l->src_len > UINT32_MAX)
+        return lx_tokenize_serial(l);
+
+    u32 want = jobs * LX_CHUNKS_PER_JOB;
+    if (want > l->src_len / LX_CHUNK_MIN)
+        want = l->src_len / LX_CHUNK_MIN;
+    if (want < 2)
+        return lx_tokenize_serial(l);
+
+    LexerChunk* chunks = calloc(want, sizeof(LexerChunk));
+    check_alloc(chunks);
+
+    LexerJobs j = {
+        .src = l->src,
+        .chunks = chunks,
+        .nchunks = lx_split(l->src, l->src_len, want, chunks),
+    };
+    pthread_mutex_init(&j.lock, NULL);
+
+    lx_run_jobs(&j, jobs, lx_lex_chunk);
+
+    // lay the chunks out one after the other. the first error wins, since the
+    // chunks after it would never have been lexed. bad utf-8 comes before any
+    // of that though, on one thread it is found before lexing even starts.
+    TokenStream toks = {0};
+    u32 total = 0, data_total = 0, strings_total = 0;
+    for (u32 i = 0; i < j.nchunks; i++) {
+        if (chunks[i].lx.error.kind == LX_ERROR_INVALID_UTF8) {
+            l->error = chunks[i].lx.error;
+            lx_perror(l->error.kind, "\033[31;1mlexer error\033[0m");
+            goto end;
+        }
+    }
+
+    for (u32 i = 0; i < j.nchunks; i++) {
+        LexerChunk* c = &chunks[i];
+        c->at = total;
+        c->data_at = data_total;
+        c->strings_at = strings_total;
+        total += c->toks.len;
+        strings_total += c->lx.strings.len;
+
+        for (u32 k = 0; k < c->toks.len; k++)
+            data_total += token_has_data(c->toks.data[k].kind);
+
+        l->cur = c->lx.cur;
+        l->token = c->lx.token;
+        l->error = c->lx.error;
+
+        if (l->error.kind != LX_ERROR_NULL) {
+            lx_perror(l->error.kind, "\033[31;1mlexer error\033[0m");
+            goto end;
+        }
+
+        // there are far fewer distinct names than identifiers, so merging
+        // the tables here is cheap.
+        c->remap = malloc(sizeof(u32) * (c->syms.len + 1));
+        check_alloc(c->remap);
+        for (u32 k = 0; k < c->syms.len; k++)
+            c->remap[k] = sym_intern(l->syms, sym_name(&c->syms, k),
+                                     sym_len(&c->syms, k));
+    }
+
+    // and copy them over in parallel as well, this is a lot of memory
+    ts_reserve(&toks, total, data_total);
+    toks.len = total;
+    toks.data_len = data_total;
+    toks.syms = l->syms;
+    if (strings_total != 0) {
+        toks.strings = as_with_capacity(strings_total + 1);
+        toks.strings.len = strings_total;
+    }
+
+    j.dest = &toks;
+    lx_run_jobs(&j, jobs, lx_copy_chunk);
+
+end:
+    for (u32 i = 0; i < j.nchunks; i++) {
+        av_free(&chunks[i].toks);
+        as_free(&chunks[i].lx.strings);
+        sym_free(&chunks[i].syms);
+        free(chunks[i].remap);
+    }
+    free(chunks);
+    pthread_mutex_destroy(&j.lock);
+
+    return toks;
+}
+
+TokenStream lx_tokenize(Lexer* l) {
+    return lx_tokenize_jobs(l, 0);
+}
+
+// lexing restarts right after the last newline token before the edit. nothing
+// the lexer does looks past a newline, so everything up to it stays the same.
+// it stops again at the first newline token past the edit that lines up with
+// one in the old stream: from there on both sources are the same, and so are
+// the tokens, only moved by the edit.
+bool lx_relex(TokenStream* ts, a_string* src, LexerEdit edit, LexerError* err) {
+    if (edit.off > src->len || edit.removed > src->len - edit.off)
+        panic("edit at %u (%u bytes) is out of range", edit.off,
+              edit.removed);
+
+    u32 start = 0, restart = 0;
+    for (u32 i = 0; i < ts->len; i++) {
+        if (ts->kinds[i] != TOK_NEWLINE)
+            continue;
+
+        u32 off = ts->pos[i].off;
+        if (off >= edit.off)
+            break;
+
+        start = off + 1;
+        restart = i + 1;
+    }
+
+    // edit the source
+    u32 edit_end = edit.off + edit.removed;
+    usize new_len = src->len - edit.removed + edit.inserted_len;
+    if (new_len + 1 > src->cap)
+        as_reserve(src, new_len + 1);
+    memmove(&src->data[edit.off + edit.inserted_len], &src->data[edit_end],
+            src->len - edit_end);
+    memcpy(&src->data[edit.off], edit.inserted, edit.inserted_len);
+    src->len = new_len;
+    src->data[new_len] = '\0';
+
+    // how far everything after the edit moves. wraps around when the source
+    // shrinks, which still adds up.
+    u32 shift = edit.inserted_len - edit.removed;
+
+    // the rest of the source was checked when it was first lexed, so only the
+    // lines the edit touched can have gone bad
+    const char* end_line = sc_find(&src->data[edit.off + edit.inserted_len],
+                                   &src->data[src->len], '\n');
+    const char* bad = sc_utf8_check(&src->data[start], end_line);
+    if (bad != end_line) {
+        *err = (LexerError){
+            .kind = LX_ERROR_INVALID_UTF8,
+            .pos = {.off = bad - src->data, .len = 1},
+        };
+        ts->len = ts->data_len = 0;
+        return false;
+    }
+
+    Lexer l = lx_new(src->data, src->len, ts->syms);
+    l.cur = start;
+    l.checked = src->len;
+
+    TokenStream mid = {0};
+    u32 end = ts->len;  // old tokens from `restart` up to here are replaced
+    u32 j = restart;    // old token that is being lined up with
+    for (;;) {
+        Token* t = lx_next_token(&l);
+        if (t == NULL) {
+            *err = l.error;
+            ts_free(&mid);
+            lx_free(&l);
+            ts->len = ts->data_len = 0;
+            return false;
+        }
+
+        ts_push(&mid, t);
+        if (t->kind == TOK_EOF)
+            break;
+
+        if (t->kind != TOK_NEWLINE || t->pos.off < edit.off + edit.inserted_len)
+            continue;
+
+        u32 old_off = t->pos.off - shift;
+        while (j < ts->len &&
+               (ts->kinds[j] != TOK_NEWLINE || ts->pos[j].off < old_off))
+            j++;
+
+        if (j < ts->len && ts->pos[j].off == old_off) {
+            end = j + 1;
+            break;
+        }
+    }
+
+    // splice the new tokens in
+    u32 data_restart =
+        (restart < ts->len) ? ts->data_idx[restart] : ts->data_len;
+    u32 data_end = (end < ts->len) ? ts->data_idx[end] : ts->data_len;
+
+    u32 tail = ts->len - end, data_tail = ts->data_len - data_end;
+    u32 at = restart + mid.len, data_at = data_restart + mid.data_len;
+    ts_reserve(ts, at + tail, data_at + data_tail);
+
+    memmove(&ts->kinds[at], &ts->kinds[end], tail);
+    memmove(&ts->pos[at], &ts->pos[end], sizeof(Pos) * tail);
+    memmove(&ts->data_idx[at], &ts->data_idx[end], sizeof(u32) * tail);
+    memmove(&ts->data[data_at], &ts->data[data_end],
+            sizeof(TokenData) * data_tail);
+
+    memcpy(&ts->kinds[restart], mid.kinds, mid.len);
+    memcpy(&ts->pos[restart], mid.pos, sizeof(Pos) * mid.len);
+    memcpy(&ts->data[data_restart], mid.data, sizeof(TokenData) * mid.data_len);
+    for (u32 i = 0; i < mid.len; i++) {
+        u32 d = mid.data_idx[i] + data_restart;
+        ts->data_idx[restart + i] = d;
+
+        // the new decoded strings go after the old ones
+        if (token_has_span(mid.kinds[i]) &&
+            (ts->data[d].span.off & SPAN_DECODED))
+            ts->data[d].span.off += ts->strings.len;
+    }
+    if (l.strings.len != 0)
+        lx_strings_append(&ts->strings, l.strings.data, l.strings.len);
+
+    // and move the rest along
+    u32 data_shift = data_at - data_end;
+    for (u32 i = at; i < at + tail; i++) {
+        ts->pos[i].off += shift;
+        ts->data_idx[i] += data_shift;
+
+        if (!token_has_span(ts->kinds[i]))
+            continue;
+
+        Span* sp = &ts->data[ts->data_idx[i]].span;
+        if (!(sp->off & SPAN_DECODED))
+            sp->off += shift;
+    }
+
+    ts->len = at + tail;
+    ts->data_len = data_at + data_tail;
+    ts_free(&mid);
+    lx_free(&l);
+    return true;
+}
+
 void lx_free(Lexer* l) {
-    (void)l;
-    lx_kwt_free();
+    if (l->window) {
+        free(l->window);
+        l->window = NULL;
+    }
+
+    as_free(&l->strings);
 }
 
-char* lx_strerror(LexerErrorKind k) {
-    char* s;
+const char* lx_strerror(LexerErrorKind k) {
+    const char* s = "";
     switch (k) {
         case LX_ERROR_NULL: {
             s = "(no error)";
@@ -834,9 +1865,12 @@ char* lx_strerror(LexerErrorKind k) {
         case LX_ERROR_CHAR_LITERAL_TOO_LONG: {
             s = "character literal is too long";
         } break;
+        case LX_ERROR_INVALID_UTF8: {
+            s = "invalid utf-8";
+        } break;
     }
 
-    return strncpy(ERROR_BUF, s, ERROR_BUFSZ - 1);
+    return s;
 }
 
 a_string lx_as_strerror(LexerErrorKind k) {
@@ -844,12 +1878,10 @@ a_string lx_as_strerror(LexerErrorKind k) {
 }
 
 void lx_perror(LexerErrorKind k, const char* pre) {
-    char* err = lx_strerror(k);
-    printf("%s: %s\n", pre, err);
+    const char* err = lx_strerror(k);
+    eprintf("%s: %s\n", pre, err);
 }
 
 void lx_reset(Lexer* l) {
-    l->row = 1;
-    l->bol = 0;
     l->cur = 0;
 }
@@ -12,23 +12,127 @@
 
 #include "a_string.h"
 #include "a_vector.h"
+#include "arena.h"
 #include "common.h"
+#include "source.h"
+#include "symtab.h"
+#include "writer.h"
 
 #include "lexertypes.h"
 
 AV_DECL(Token, Tokens)
 
-Token token_new_ident(const char* str);
+Token token_new_ident(u32 sym);
+// the returned string is static, do not free or modify it.
+const char* token_kind_name(TokenKind k);
 a_string token_kind_to_string(TokenKind k);
-void token_print_long(Token* t);
+// writes a token on a line of its own. `src` and `strings` are as for
+// `token_text`. the position is given as a row and column if there are `lines`
+// to look it up in, otherwise as a byte offset.
+void token_write(Writer* w, const Token* t, const char* src,
+                 const char* strings, const SymbolTable* syms,
+                 LineTable* lines);
 void token_print(Token* t);
 Token token_dupe(Token* t);
 
+// gets the text of a literal token without copying it. the text is
+// not null terminated, its length is `t->data.span.len`. `src` must be the
+// buffer the token was lexed from, and `strings` the decoded string literals
+// that go with it (`l->strings.data` or `ts->strings.data`).
+//
+// string literals come out with their escapes resolved, character literals
+// still have them. identifiers only have a symbol id, see `sym_name`.
+const char* token_text(const Token* t, const char* src, const char* strings);
+
+// resolves the character after a backslash in a literal. returns -1 if it is
+// not a valid escape.
+char lx_escape(char ch);
+
 // free heap allocated data.
 // of course, you can still read the kind if you have to.
 void token_free(Token* t);
 
+// a token stream stored as a structure of arrays. the parser mostly looks at
+// nothing but the kinds, so those are packed on their own. only identifiers
+// and literals carry any data, which lives in a side table.
+//
+// the arrays live in an arena, so a stream is freed in one go. when they have
+// to grow they are moved to new space in it, and the old space is only given
+// back with the rest. streams made with ts_new are sized up front so that
+// this hardly ever happens.
+typedef struct {
+    u8* kinds;
+    Pos* pos;
+    u32* data_idx; // index into `data`, if the token has any
+    u32 len;
+    u32 cap;
+
+    TokenData* data;
+    u32 data_len;
+    u32 data_cap;
+
+    a_string strings; // decoded string literals, see SPAN_DECODED
+    SymbolTable* syms; // the lexer's, where the identifiers are interned
+
+    Arena arena; // where the arrays are
+} TokenStream;
+
+// a guess at the number of bytes per token, on the low side: space that is
+// never used is never touched either, so it costs next to nothing.
+#define TS_BYTES_PER_TOKEN 4
+
+bool token_has_data(TokenKind k);
+// whether the token's data is a span of the source.
+bool token_has_span(TokenKind k);
+
+// an empty stream with room for the tokens of a source `src_len` bytes long,
+// all in one allocation. a zeroed stream works too, it just grows as it goes.
+TokenStream ts_new(usize src_len);
+void ts_push(TokenStream* ts, const Token* t);
+// puts token `i` back together.
+Token ts_at(const TokenStream* ts, u32 i);
+void ts_reserve(TokenStream* ts, u32 cap, u32 data_cap);
+void ts_free(TokenStream* ts);
+
+typedef enum {
+    TS_DUMP_TEXT = 0,
+    TS_DUMP_BINARY,
+} TokenDumpFormat;
+
+#define TS_DUMP_MAGIC   "CIMITOKS"
+#define TS_DUMP_VERSION 1
+
+// writes out the whole stream, lexed from `src`. the text format is one
+// `token_write` line per token.
+//
+// the binary format is in native byte order, with nothing in between fields:
+//
+//  header:  TS_DUMP_MAGIC (8 bytes), u32 version, u32 token count,
+//           u32 symbol count
+//  symbols: for each id from 0 up, u32 length, then the name
+//  tokens:  u8 kind, u32 offset, u32 length, then depending on the kind
+//           - ident: u32 symbol id
+//           - string, char, number: u32 length, then the text. strings are
+//             decoded, the others are as they are in the source
+//           - bool: u8
+//           - int: i64, float: f64
+void ts_dump(const TokenStream* ts, const char* src, usize src_len, Writer* w,
+             TokenDumpFormat fmt);
+
+// default size of the input window of a streaming lexer.
+#define LX_STREAM_WINDOW (64 * 1024)
+
+typedef enum {
+    LX_COMMENT_NONE = 0,
+    LX_COMMENT_LINE,
+    LX_COMMENT_BLOCK,
+} LexerCommentKind;
+
+// all lexer state lives in here, so separate lexers may be used from separate
+// threads at the same time.
 typedef struct {
+    // for a streaming lexer, this is the current input window. the cursor and
+    // token spans are relative to it, token positions are not.
     const char* src;
     usize src_len;
 
@@ -38,19 +142,80 @@ typedef struct {
     // error (public)
     LexerError error;
 
+    // string literals with escapes in them are decoded into here as they are
+    // lexed. lx_tokenize hands it over to the token stream.
+    a_string strings;
+
+    // identifiers are interned in here. not owned by the lexer.
+    SymbolTable* syms;
+
     // internal lexer state
     u32 cur;
-    u32 row;
-    u32 bol;
+    u32 checked; // everything before this is known to be valid utf-8
+
+    // streaming state
+    bool streaming;
+    bool stream_eof;
+    FILE* fp; // read through stdio if set, otherwise from fd
+    int fd;
+    u32 base; // offset of the window in the whole input
+    char* window;
+    usize window_cap;
+    LexerCommentKind comment; // comment that the window ran out in
 } Lexer;
 
-Lexer lx_new(const char* src, usize src_len);
+// identifiers are interned into `syms`, which has to outlive the lexer and any
+// tokens that come out of it. the whole input is checked to be valid utf-8 on
+// the first call to lx_next_token.
+Lexer lx_new(const char* src, usize src_len, SymbolTable* syms);
+
+// creates a lexer that reads its input through a fixed size window that is
+// refilled as it goes, so memory use does not depend on the size of the input.
+// the window only grows if a single token does not fit in it. a window of 0
+// means LX_STREAM_WINDOW.
+//
+// the text of a token (see `token_text`, pass `l->src` and `l->strings.data`)
+// is only valid until the next call to lx_next_token, so lx_tokenize cannot be
+// used on these. the stream is not closed by lx_free.
+//
+// the input is checked to be valid utf-8 a window at a time, so unlike with
+// lx_new, tokens before bad utf-8 still come out.
+Lexer lx_new_stream(FILE* fp, usize window, SymbolTable* syms);
+Lexer lx_new_fd(int fd, usize window, SymbolTable* syms);
+
+// an edit to a source buffer: `removed` bytes at `off` are replaced with
+// `inserted`.
+typedef struct {
+    u32 off;
+    u32 removed;
+    const char* inserted;
+    u32 inserted_len;
+} LexerEdit;
+
+// applies `edit` to `src`, and updates `ts`, which was lexed from it by
+// lx_tokenize, to match. new identifiers go into `ts->syms`. only as much of
+// the source as the edit could have changed is lexed again, the tokens after
+// that are just moved along.
+//
+// on a lexer error, false is returned and the error is left in `err`. the
+// source is edited either way, but the stream is left empty.
+//
+// decoded string literals of the tokens that were replaced are left behind in
+// `ts->strings` until the stream is freed.
+bool lx_relex(TokenStream* ts, a_string* src, LexerEdit edit, LexerError* err);
+
 Token* lx_next_token(Lexer* l);
 void lx_free(Lexer* l);
 void lx_reset(Lexer* l);
-char* lx_strerror(LexerErrorKind e);
+// the returned string is static, do not free or modify it.
+const char* lx_strerror(LexerErrorKind e);
 a_string lx_as_strerror(LexerErrorKind e);
 void lx_perror(LexerErrorKind e, const char* pre);
-Tokens lx_tokenize(Lexer* l);
+
+// lexes the whole input. large inputs are cut into chunks at newlines outside
+// of literals and block comments, which are lexed on one thread per core.
+TokenStream lx_tokenize(Lexer* l);
+// same as lx_tokenize, but on at most `jobs` threads. 0 means one per core.
+TokenStream lx_tokenize_jobs(Lexer* l, u32 jobs);
 
 #endif // _LEXER_H
@@ -13,11 +13,11 @@
 #include "a_string.h"
 #include "common.h"
 
+// where something is in the source, as a byte offset and a length. rows and
+// columns are only worked out when they are printed, see LineTable.
 typedef struct {
-    u32 row;
-    u16 file_id;
-    u8 col;
-    u8 span;
+    u32 off;
+    u32 len;
 } Pos;
 
 typedef enum {
@@ -28,6 +28,7 @@ typedef enum {
     LX_ERROR_MISMATCHED_DELIMITER,
     LX_ERROR_INVALID_IDENTIFIER,
     LX_ERROR_CHAR_LITERAL_TOO_LONG,
+    LX_ERROR_INVALID_UTF8,
 } LexerErrorKind;
 
 typedef struct {
@@ -44,8 +45,10 @@ typedef enum {
     // Literals
     TOK_LITERAL_STRING,
     TOK_LITERAL_CHAR,
-    TOK_LITERAL_NUMBER,
+    TOK_LITERAL_NUMBER, // a number that does not fit, see lx_next_number
     TOK_LITERAL_BOOLEAN,
+    TOK_LITERAL_INT,
+    TOK_LITERAL_FLOAT,
 
     // Keywords
     TOK_LET,
@@ -116,13 +119,29 @@ typedef enum {
     TOK_DIV_ASSIGN,
 } TokenKind;
 
+// a view into the lexer's source buffer, or, for string literals with escapes
+// in them, into the buffer their decoded text was written to. never owns any
+// memory.
+typedef struct {
+    u32 off;
+    u32 len;
+} Span;
+
+// set in `off` if the span is decoded text rather than source.
+#define SPAN_DECODED (1u << 31)
+
+typedef union {
+    Span span;    // string, char and number literals, newlines
+    u32 sym;      // idents, see symtab.h
+    bool boolean; // bool literals
+    i64 integer;  // int literals
+    f64 floating; // float literals
+} TokenData;
+
 typedef struct {
     TokenKind kind;
     Pos pos;
-    union {
-        a_string string; // idents, other literals
-        bool boolean;    // bool literals
-    } data;
+    TokenData data;
 } Token;
 
 #endif // _LEXERTYPES_H
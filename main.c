@@ -7,11 +7,13 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
-#include <stdio.h>
 #define _POSIX_C_SOURCE 200809L
 #define _GNU_SOURCE
 
 #include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h> // used by macro
 
 #include "a_string.h"
@@ -22,22 +24,54 @@
 #include "lexer.h"
 #include "lexertypes.h"
 #include "parser.h"
+#include "program.h"
+#include "source.h"
+#include "writer.h"
 
 // #include "tests/ast_printer.c"
 
+static void usage(void) {
+    eprintf("usage: cimi [--dump-tokens[=text|binary]] [--cache | --no-cache] "
+            "[file]\n");
+    exit(1);
+}
+
 i32 main(i32 argc, char* argv[argc]) {
     argv++;
     argc--;
 
-    a_string s = {0};
+    // tokens are only written out when asked for, and nothing is parsed then
+    bool dump_tokens = false;
+    TokenDumpFormat dump_fmt = TS_DUMP_TEXT;
+    // module files are only written when asked for, see modfile.h
+    PgModfiles modfiles = PG_MODFILES_READ;
+    for (; argc > 0 && !strncmp(argv[0], "--", 2); argv++, argc--) {
+        if (!strcmp(argv[0], "--dump-tokens") ||
+            !strcmp(argv[0], "--dump-tokens=text")) {
+            dump_tokens = true;
+        } else if (!strcmp(argv[0], "--dump-tokens=binary")) {
+            dump_tokens = true;
+            dump_fmt = TS_DUMP_BINARY;
+        } else if (!strcmp(argv[0], "--cache")) {
+            modfiles = PG_MODFILES_WRITE;
+        } else if (!strcmp(argv[0], "--no-cache")) {
+            modfiles = PG_MODFILES_OFF;
+        } else {
+            usage();
+        }
+    }
+
+    SourceFile s = {0};
     if (argc == 0) {
-        s = as_new();
-        if (!as_read_line(&s, stdin))
+        a_string line = as_new();
+        if (!as_read_line(&line, stdin))
             panic("could not read line from stdin");
-    } else {
-        s = as_read_file(argv[0]);
+        s = (SourceFile){.data = line.data, .len = line.len, .buf = line};
+    } else if (!sf_open(&s, argv[0])) {
         if (errno == ENOENT)
             panic("file \"%s\" not found", argv[0]);
+        else
+            panic("could not read file \"%s\": %s", argv[0], strerror(errno));
     }
 
     a_string filename = {0};
@@ -47,27 +81,41 @@ i32 main(i32 argc, char* argv[argc]) {
         filename = astr(argv[0]);
     }
 
-    Lexer l = lx_new(s.data, s.len);
-    Tokens toks = lx_tokenize(&l);
+    if (dump_tokens) {
+        SymbolTable syms = sym_new();
+        Lexer l = lx_new(s.data, s.len, &syms);
+        TokenStream toks = lx_tokenize(&l);
 
-    Parser ps = ps_new(filename, toks.data, toks.len);
-    MaybeExpr exp = ps_expr(&ps);
-    if_let(C_Expr, e, exp) {
-        AstPrinter p = ap_new();
-        ap_visit_expr(&p, &e);
-        putchar('\n');
-        C_Expr_free(&e);
+        // the error has been reported already
+        bool ok = l.error.kind == LX_ERROR_NULL;
+        if (ok) {
+            Writer w = wr_new(stdout);
+            ts_dump(&toks, s.data, s.len, &w, dump_fmt);
+            wr_free(&w);
+        }
+
+        ts_free(&toks);
+        lx_free(&l);
+        sym_free(&syms);
+        sf_close(&s);
+        as_free(&filename);
+        return ok ? 0 : 1;
     }
-    else {
+
+    // the source is lexed as it is parsed, alongside whatever it includes
+    Program pg = pg_load(filename, s, 0, modfiles);
+    if (pg.ok) {
+        AstPrinter p = ap_new();
+        p.syms = &pg.syms;
+        for (u32 i = 0; i < pg.items.len; i++) {
+            p.ast = &pg.items.data[i].module->ast;
+            ap_visit_expr(&p, pg.items.data[i].expr);
+            putchar('\n');
+        }
+    } else {
         eprintf("got error\n");
     }
 
-    for (usize i = 0; i < toks.len; i++) {
-        token_free(&toks.data[i]);
-    }
-    av_free(&toks);
-    lx_free(&l);
-    ps_free(&ps);
-    as_free(&s);
+    pg_free(&pg);
     return 0;
 }
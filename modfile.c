@@ -0,0 +1,280 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "a_string.h"
+#include "ast.h"
+#include "common.h"
+#include "modfile.h"
+#include "source.h"
+#include "symtab.h"
+#include "writer.h"
+
+#define MF_ALIGN(n) (((u64)(n) + 7) & ~(u64)7)
+
+#define WR_RAW(w, x) wr_write((w), &(x), sizeof(x))
+
+a_string mf_path(const a_string* path) {
+    const char* ext = ".cimi";
+    usize n = strlen(ext);
+    if (path->len >= n && !strcmp(path->data + path->len - n, ext))
+        return as_asprintf("%sc", path->data);
+    else
+        return as_asprintf("%s.cimic", path->data);
+}
+
+// adds the hash of one piece of the file to its sum. every name, with its
+// null, and every pool is a piece, so the sum can be worked out as it is
+// written, without the pieces being in one place.
+static u64 mf_mix(u64 sum, const void* data, usize len) {
+    sum = (sum ^ sf_hash_bytes(data, len)) * 0xff51afd7ed558ccdULL;
+    return sum ^ (sum >> 29);
+}
+
+// zeros up to offset `to`, which is less than 8 bytes on.
+static void mf_pad(Writer* w, u64* at, u64 to) {
+    static const char zeros[8] = {0};
+    wr_write(w, zeros, to - *at);
+    *at = to;
+}
+
+static void mf_write(Writer* w, u64 src_hash, Ast* a, const SymbolTable* syms,
+                     C_Block body) {
+    AstPoolRef pools[AST_NPOOLS];
+    ast_pools(a, pools);
+
+    MfHeader h;
+    memset(&h, 0, sizeof(h)); // the padding too, it is written out
+    memcpy(h.magic, MF_MAGIC, sizeof(h.magic));
+    strncpy(h.version, VERSION, sizeof(h.version));
+    h.format = MF_FORMAT;
+    h.byte_order = MF_BYTE_ORDER;
+    h.src_hash = src_hash;
+    h.body = body;
+    h.nsyms = syms->len;
+    h.npools = AST_NPOOLS;
+    for (u32 i = 0; i < syms->len; i++) {
+        h.names_len += sym_len(syms, i) + 1;
+        h.sum = mf_mix(h.sum, sym_name(syms, i), sym_len(syms, i) + 1);
+    }
+
+    u64 at = MF_ALIGN(sizeof(h));
+    u64 off = MF_ALIGN(at + sizeof(u32) * h.nsyms + h.names_len);
+    for (u32 i = 0; i < AST_NPOOLS; i++) {
+        h.pools[i] = (MfPool){
+            .size = pools[i].size,
+            .len = *pools[i].len,
+            .off = off,
+        };
+        off = MF_ALIGN(off + (u64)h.pools[i].size * h.pools[i].len);
+        h.sum = mf_mix(h.sum, *pools[i].data,
+                       (usize)h.pools[i].size * h.pools[i].len);
+    }
+
+    WR_RAW(w, h);
+    at = sizeof(h);
+    mf_pad(w, &at, MF_ALIGN(at));
+
+    for (u32 i = 0; i < syms->len; i++) {
+        u32 len = sym_len(syms, i);
+        WR_RAW(w, len);
+    }
+    for (u32 i = 0; i < syms->len; i++)
+        wr_write(w, sym_name(syms, i), sym_len(syms, i) + 1);
+    at += sizeof(u32) * h.nsyms + h.names_len;
+
+    for (u32 i = 0; i < AST_NPOOLS; i++) {
+        mf_pad(w, &at, h.pools[i].off);
+        u64 size = (u64)h.pools[i].size * h.pools[i].len;
+        if (size != 0)
+            wr_write(w, *pools[i].data, size);
+        at += size;
+    }
+}
+
+// a new file next to `path` to write to, with the permissions any new file
+// would get. mkstemp would make it 0600 whatever the umask says.
+static int mf_create_tmp(const char* path, a_string* tmp) {
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static u32 count;
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        u32 n = count++;
+        pthread_mutex_unlock(&lock);
+
+        *tmp = as_asprintf("%s.%ld.%u", path, (long)getpid(), n);
+        int fd = open(tmp->data, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd != -1 || errno != EEXIST)
+            return fd;
+        as_free(tmp);
+    }
+}
+
+bool mf_save(const char* path, u64 src_hash, Ast* a, const SymbolTable* syms,
+             C_Block body) {
+    a_string tmp;
+    int fd = mf_create_tmp(path, &tmp);
+    if (fd == -1) {
+        int err = errno;
+        as_free(&tmp);
+        errno = err;
+        return false;
+    }
+
+    FILE* fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        close(fd);
+        goto fail;
+    }
+
+    Writer w = wr_new(fp);
+    mf_write(&w, src_hash, a, syms, body);
+    wr_free(&w);
+
+    bool ok = !ferror(fp);
+    if (fclose(fp) != 0 || !ok)
+        goto fail;
+
+    if (rename(tmp.data, path) == -1)
+        goto fail;
+
+    as_free(&tmp);
+    return true;
+
+fail:;
+    int err = errno;
+    unlink(tmp.data);
+    as_free(&tmp);
+    errno = err;
+    return false;
+}
+
+// whether the file was written by this version of cimi, for this source, and
+// everything in the header is inside the file.
+static bool mf_check(const ModuleFile* mf, u64 src_hash) {
+    const MfHeader* h = mf->map;
+    if (memcmp(h->magic, MF_MAGIC, sizeof(h->magic)) != 0 ||
+        strncmp(h->version, VERSION, sizeof(h->version)) != 0 ||
+        h->format != MF_FORMAT || h->byte_order != MF_BYTE_ORDER ||
+        h->src_hash != src_hash || h->npools != AST_NPOOLS)
+        return false;
+
+    u64 syms_end = MF_ALIGN(sizeof(*h)) + sizeof(u32) * h->nsyms;
+    if (syms_end + h->names_len > mf->len)
+        return false;
+
+    Ast a = {0};
+    AstPoolRef pools[AST_NPOOLS];
+    ast_pools(&a, pools);
+    for (u32 i = 0; i < AST_NPOOLS; i++) {
+        const MfPool* p = &h->pools[i];
+        if (p->size != pools[i].size || p->off % 8 != 0 || p->off > mf->len ||
+            (u64)p->size * p->len > mf->len - p->off)
+            return false;
+    }
+
+    return true;
+}
+
+bool mf_load(ModuleFile* mf, const char* path, u64 src_hash, Ast* a,
+             SymbolTable* syms, C_Block* body) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return false;
+    }
+
+    if ((u64)st.st_size < sizeof(MfHeader)) {
+        close(fd);
+        errno = ESTALE;
+        return false;
+    }
+
+    // private, so the nodes can be written to without the file changing
+    void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                   0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        errno = err;
+        return false;
+    }
+
+    *mf = (ModuleFile){.map = p, .len = st.st_size};
+    if (!mf_check(mf, src_hash))
+        goto stale;
+
+    // the symbols are interned again in the same order, so they get the same
+    // ids as before
+    const MfHeader* h = p;
+    const u32* lens = (const u32*)((char*)p + MF_ALIGN(sizeof(*h)));
+    const char* names = (const char*)(lens + h->nsyms);
+    const char* names_end = names + h->names_len;
+
+    u64 sum = 0;
+    SymbolTable t = sym_new();
+    for (u32 i = 0; i < h->nsyms; i++) {
+        if (lens[i] >= (usize)(names_end - names) || names[lens[i]] != '\0' ||
+            sym_intern(&t, names, lens[i]) != i) {
+            sym_free(&t);
+            goto stale;
+        }
+        sum = mf_mix(sum, names, lens[i] + 1);
+        names += lens[i] + 1;
+    }
+
+    Ast tree = ast_new();
+    AstPoolRef pools[AST_NPOOLS];
+    ast_pools(&tree, pools);
+    for (u32 i = 0; i < AST_NPOOLS; i++) {
+        const MfPool* pool = &h->pools[i];
+        *pools[i].data = (pool->len != 0) ? (char*)p + pool->off : NULL;
+        *pools[i].len = *pools[i].cap = pool->len;
+        sum = mf_mix(sum, *pools[i].data, (usize)pool->size * pool->len);
+    }
+
+    if (sum != h->sum || !ast_check(&tree, h->nsyms, h->body)) {
+        sym_free(&t);
+        goto stale;
+    }
+
+    *a = tree;
+    *syms = t;
+    *body = h->body;
+    return true;
+
+stale:
+    mf_close(mf);
+    errno = ESTALE;
+    return false;
+}
+
+void mf_close(ModuleFile* mf) {
+    if (mf->map != NULL)
+        munmap(mf->map, mf->len);
+    *mf = (ModuleFile){0};
+}
@@ -0,0 +1,91 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _MODFILE_H
+#define _MODFILE_H
+
+#include "a_string.h"
+#include "ast.h"
+#include "common.h"
+#include "symtab.h"
+
+// precompiled modules. a parsed file can be saved next to its source, as
+// "name.cimic" for "name.cimi", and mapped back in later without being lexed
+// or parsed again. the nodes refer to each other by index, so the pools of the
+// tree are written out as they are, and used in place when they are read.
+//
+// the format is in native byte order, and every section starts on an 8 byte
+// boundary:
+//
+//  header:  MfHeader, see below
+//  symbols: u32 length of each, from id 0 up, then the names one after the
+//           other, each null terminated
+//  pools:   the nodes of each pool of the tree, in ast_pools order, where
+//           the header says
+//
+// a file is only used if it was written by the same version of cimi, for
+// a source with the same hash, its sum matches, and the tree in it passes
+// ast_check. one that is stale, cut short, damaged or made up is never used,
+// and the source is parsed instead.
+
+#define MF_MAGIC      "CIMIMODC"
+#define MF_FORMAT     2
+#define MF_BYTE_ORDER 0x01020304
+
+typedef struct {
+    u32 size; // of one node
+    u32 len;
+    u64 off;
+} MfPool;
+
+typedef struct {
+    char magic[8];
+    char version[16]; // VERSION, null padded
+    u32 format;       // MF_FORMAT
+    u32 byte_order;   // MF_BYTE_ORDER
+    u64 src_hash;     // see sf_hash
+    u64 sum;          // of the symbols and the pools, to catch bad bytes
+    C_Block body;
+    u32 nsyms;
+    u32 names_len;
+    u32 npools;
+    MfPool pools[AST_NPOOLS];
+} MfHeader;
+
+// a mapped module file.
+typedef struct {
+    void* map;
+    usize len;
+} ModuleFile;
+
+// where the module file for the source at `path` goes.
+a_string mf_path(const a_string* path);
+
+// saves a parsed module: its tree, its symbols and its top level. it is
+// written to a new file which then takes the place of `path`, so a file that
+// is being read is never changed.
+//
+// returns false and sets errno on error.
+bool mf_save(const char* path, u64 src_hash, Ast* a, const SymbolTable* syms,
+             C_Block body);
+
+// maps a module file in, if there is one that is good for a source with hash
+// `src_hash`. the pools of `a` are in the mapping, which is copy on write, so
+// nodes may be changed but no more can be added. `syms` is set to a new table,
+// which has to be freed as usual. neither is touched unless this works.
+//
+// returns false and sets errno on error, to ESTALE if the file is for another
+// version of cimi or of the source.
+bool mf_load(ModuleFile* mf, const char* path, u64 src_hash, Ast* a,
+             SymbolTable* syms, C_Block* body);
+
+// unmaps the file, and with it the tree.
+void mf_close(ModuleFile* mf);
+
+#endif // _MODFILE_H
@@ -7,12 +7,10 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
-#include "expr.h"
-#include "stmt.h"
-#include <ctype.h>
-#include <errno.h>
 #define _POSIX_C_SOURCE 200809L
 
+#include <ctype.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -21,108 +19,172 @@
 #include "a_string.h"
 #include "a_vector.h"
 #include "common.h"
+#include "expr.h"
 #include "lexer.h"
 #include "lexertypes.h"
 #include "parser.h"
+#include "stmt.h"
 
 #define MAX_ERROR_COUNT 20
 
-Parser ps_new(a_string file_name, Token* toks, usize len) {
-    Parser p = {.tokens = toks, .tokens_len = len, .file_name = file_name};
+Parser ps_new(a_string file_name, const char* src, usize src_len,
+              const TokenStream* toks, Ast* ast) {
+    Parser p = {
+        .toks = *toks,
+        .ast = ast,
+        .diag = stderr,
+        .file_name = file_name,
+        .src = src,
+        .lines = lt_new(src, src_len),
+    };
+    return p;
+}
+
+Parser ps_new_pull(a_string file_name, const char* src, usize src_len,
+                   SymbolTable* syms, Ast* ast) {
+    Parser p = {
+        .ast = ast,
+        .diag = stderr,
+        .file_name = file_name,
+        .src = src,
+        .lines = lt_new(src, src_len),
+        .pull = true,
+        .lx = lx_new(src, src_len, syms),
+    };
     return p;
 }
 
 void ps_free(Parser* ps) {
     lx_free(&ps->lx);
     as_free(&ps->file_name);
+    lt_free(&ps->lines);
 }
 
 static MaybeToken ps_consume(Parser* ps);
 static MaybeToken ps_peek(Parser* ps);
-static MaybeToken ps_peek_next(Parser* ps);
 static MaybeToken ps_prev(Parser* ps);
 static MaybeToken ps_get(Parser* ps, u32 idx);
-static MaybeToken ps_peek_and_expect(Parser* ps, TokenKind expected);
 static bool ps_check(Parser* ps, TokenKind expected);
 static MaybeToken ps_check_and_consume(Parser* ps, TokenKind expected);
-static MaybeToken ps_consume_and_expect(Parser* ps, TokenKind expected);
 static Pos ps_get_pos(Parser* ps);
 static bool ps_bump_error_count(Parser* ps);
 static void ps_diag_expected(Parser* ps, const char* thing);
 static void ps_diag_and_skip(Parser* ps, const char* format, ...);
 
-static MaybeToken ps_consume(Parser* ps) {
-    if (++ps->cur >= ps->tokens_len) {
-        ps->eof = true;
-        return NO_TOKEN;
-    } else {
-        return HAVE_TOKEN(&ps->tokens[ps->cur - 1]);
+// drops the decoded strings that only tokens which have left the ring point
+// into, by moving the rest to the front of the buffer. it only does so once
+// the dropped text is at least as long as what is kept, so each byte is moved
+// a bounded number of times, and the buffer stays as big as a few literals.
+static void ps_drop_strings(Parser* ps) {
+    a_string* b = &ps->lx.strings;
+    // the next token pulled takes the place of token `pulled - PS_LOOKAHEAD`
+    u32 first = 0;
+    if (ps->pulled >= PS_LOOKAHEAD)
+        first = ps->pulled - PS_LOOKAHEAD + 1;
+
+    usize keep = b->len;
+    for (u32 i = first; i < ps->pulled; i++) {
+        Token* t = &ps->ring[i % PS_LOOKAHEAD];
+        if (token_has_span(t->kind) && (t->data.span.off & SPAN_DECODED)) {
+            u32 off = t->data.span.off & ~SPAN_DECODED;
+            if (off < keep)
+                keep = off;
+        }
+    }
+
+    if (keep == 0 || keep < b->len - keep)
+        return;
+
+    memmove(b->data, &b->data[keep], b->len - keep);
+    b->len -= keep;
+    for (u32 i = first; i < ps->pulled; i++) {
+        Token* t = &ps->ring[i % PS_LOOKAHEAD];
+        if (token_has_span(t->kind) && (t->data.span.off & SPAN_DECODED))
+            t->data.span.off -= keep;
     }
 }
 
-static MaybeToken ps_peek(Parser* ps) {
-    if (ps->cur < ps->tokens_len) {
-        return HAVE_TOKEN(&ps->tokens[ps->cur]);
-    } else {
-        ps->eof = true;
-        return NO_TOKEN;
+// pulls tokens from the lexer until token `idx` has been lexed. false if the
+// input ends before that.
+static bool ps_pull(Parser* ps, u32 idx) {
+    while (ps->pulled <= idx) {
+        if (ps->lx_done)
+            return false;
+
+        ps_drop_strings(ps);
+        Token* t = lx_next_token(&ps->lx);
+        if (t == NULL) {
+            ps->lx_done = true;
+            ps_diag_at(ps, ps->lx.error.pos, "%s",
+                       lx_strerror(ps->lx.error.kind));
+            return false;
+        }
+
+        ps->ring[ps->pulled++ % PS_LOOKAHEAD] = *t;
+        ps->lx_done = t->kind == TOK_EOF;
     }
+
+    if (ps->pulled - idx > PS_LOOKAHEAD)
+        panic("token %u has already been dropped", idx);
+    return true;
 }
 
-static MaybeToken ps_peek_next(Parser* ps) {
-    if (ps->cur + 1 < ps->tokens_len) {
-        return HAVE_TOKEN(&ps->tokens[ps->cur + 1]);
-    } else {
+// whether there is a token `idx`.
+static bool ps_has(Parser* ps, u32 idx) {
+    if (ps->pull)
+        return ps_pull(ps, idx);
+    else
+        return idx < ps->toks.len;
+}
+
+// token `idx`, which must be there (see ps_has).
+static Token ps_at(Parser* ps, u32 idx) {
+    if (ps->pull)
+        return ps->ring[idx % PS_LOOKAHEAD];
+    else
+        return ts_at(&ps->toks, idx);
+}
+
+// the decoded string literals that token spans may point into.
+static const char* ps_strings(Parser* ps) {
+    return ps->pull ? ps->lx.strings.data : ps->toks.strings.data;
+}
+
+static MaybeToken ps_consume(Parser* ps) {
+    if (!ps_has(ps, ++ps->cur)) {
         ps->eof = true;
         return NO_TOKEN;
+    } else {
+        return HAVE_TOKEN(ps_at(ps, ps->cur - 1));
     }
 }
 
+static MaybeToken ps_peek(Parser* ps) {
+    return ps_get(ps, ps->cur);
+}
+
 static MaybeToken ps_prev(Parser* ps) {
-    if (ps->cur - 1 < ps->tokens_len) {
-        return HAVE_TOKEN(&ps->tokens[ps->cur - 1]);
-    } else {
+    if (ps->cur == 0) {
         ps->eof = true;
         return NO_TOKEN;
     }
+    return ps_get(ps, ps->cur - 1);
 }
 
 static MaybeToken ps_get(Parser* ps, u32 idx) {
-    if (idx < ps->tokens_len) {
-        return HAVE_TOKEN(&ps->tokens[idx]);
+    if (ps_has(ps, idx)) {
+        return HAVE_TOKEN(ps_at(ps, idx));
     } else {
         ps->eof = true;
         return NO_TOKEN;
     }
 }
 
-static MaybeToken ps_peek_and_expect(Parser* ps, TokenKind expected) {
-    a_string expected_s = token_kind_to_string(expected);
-    if_let(Token*, t, ps_peek(ps)) {
-        if (t->kind == TOK_EOF) {
-            ps_diag(ps, "expected token %s, but reached end of file",
-                    expected_s);
-        } else if (t->kind != expected) {
-            a_string got_s = token_kind_to_string(t->kind);
-            ps_diag(ps, "expected token %s, but found %s", got_s, expected_s);
-        } else {
-            as_free(&expected_s);
-            return HAVE_TOKEN(t);
-        }
-    }
-    else {
-        ps_diag(ps, "expected token %s, but got no token", expected_s);
-    }
-
-    as_free(&expected_s);
-    return NO_TOKEN;
-}
-
 static bool ps_check(Parser* ps, TokenKind expected) {
-    if_let(Token*, t, ps_peek(ps)) {
-        return t->kind == expected;
-    }
-    else {
+    if (ps_has(ps, ps->cur)) {
+        return ps_at(ps, ps->cur).kind == expected;
+    } else {
+        ps->eof = true;
         return false;
     }
 }
@@ -135,61 +197,48 @@ static MaybeToken ps_check_and_consume(Parser* ps, TokenKind expected) {
     }
 }
 
-static MaybeToken ps_consume_and_expect(Parser* ps, TokenKind expected) {
-    a_string expected_s = token_kind_to_string(expected);
-    if_let(Token*, t, ps_consume(ps)) {
-        if (t->kind != expected) {
-            a_string actual_s = token_kind_to_string(t->kind);
-            ps_diag(ps, "expected token \"%s\" but got \"%s\"", expected_s.data,
-                    actual_s.data);
-            as_free(&actual_s);
-        } else {
-            return HAVE_TOKEN(t);
-        }
-    }
-    else {
-        ps_diag(ps,
-                "expected token \"%s\" but reached the end of the token stream",
-                expected_s.data);
-    }
-    as_free(&expected_s);
-    return NO_TOKEN;
-}
-
 static Pos ps_get_pos(Parser* ps) {
-    if_let(Token*, t, ps_prev(ps)) {
-        return t->pos;
+    if_let(Token, t, ps_prev(ps)) {
+        return t.pos;
     }
     else {
         panic("no previous token");
     }
 }
 
-void ps_diag_at(Parser* ps, Pos pos, const char* format, ...) {
-    eprintf("\033[31;1merror: \033[0;1m%.*s:%u:%u: \033[0m",
-            (int)ps->file_name.len, ps->file_name.data, pos.row, pos.col);
+static void ps_vreport(FILE* fp, const a_string* file_name, LineTable* lines,
+                       Pos pos, const char* format, va_list args) {
+    LineCol lc = lt_locate(lines, pos.off);
+    fprintf(fp, "\033[31;1merror: \033[0;1m%.*s:%u:%u: \033[0m",
+            (int)file_name->len, file_name->data, lc.row, lc.col);
+    vfprintf(fp, format, args);
+    fputc('\n', fp);
+}
 
+void ps_report(FILE* fp, const a_string* file_name, LineTable* lines, Pos pos,
+               const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    ps_vreport(fp, file_name, lines, pos, format, args);
+    va_end(args);
+}
+
+void ps_diag_at(Parser* ps, Pos pos, const char* format, ...) {
     va_list args;
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    ps_vreport(ps->diag, &ps->file_name, &ps->lines, pos, format, args);
     va_end(args);
 
-    putchar('\n');
     ps->error_reported = true;
 }
 
 void ps_diag(Parser* ps, const char* format, ...) {
-    Pos pos = ps_get_pos(ps);
-    // FIXME: less code duplication due to va_list
-    eprintf("\033[31;1merror: \033[0;1m%.*s:%u:%u: \033[0m",
-            (int)ps->file_name.len, ps->file_name.data, pos.row, pos.col);
-
     va_list args;
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    ps_vreport(ps->diag, &ps->file_name, &ps->lines, ps_get_pos(ps), format,
+               args);
     va_end(args);
 
-    putchar('\n');
     ps->error_reported = true;
 }
 
@@ -198,254 +247,530 @@ static bool ps_bump_error_count(Parser* ps) {
 }
 
 static void ps_diag_expected(Parser* ps, const char* thing) {
-    if_let(Token*, tok, ps_peek(ps)) {
-        a_string tokstring = token_kind_to_string(tok->kind);
-        ps_diag(ps, "expected %s, but found token \"%s\"", tokstring.data);
-        as_free(&tokstring);
-    }
-    else {
-        ps_diag(ps, "expected %s, but found no token", thing);
-    }
-}
-
-static void ps_diag_and_skip(Parser* ps, const char* format, ...);
-
-static void ps_consume_newlines(Parser* ps) {
-    while_let(Token*, tok, ps_peek(ps)) {
-        if (tok->kind == TOK_NEWLINE) {
-            ps_consume(ps);
-        } else {
-            break;
-        }
+    // without a token, the lexer has said what went wrong already
+    if (!ps_has(ps, ps->cur))
+        return;
+
+    Token t = ps_at(ps, ps->cur);
+    if (t.kind == TOK_EOF) {
+        ps_diag_at(ps, t.pos, "expected %s, but reached the end of the file",
+                   thing);
+    } else {
+        ps_diag_at(ps, t.pos, "expected %s, but found token \"%s\"", thing,
+                   token_kind_name(t.kind));
     }
 }
 
-MaybeExpr ps_ident(Parser* ps) {
-    if_let(Token*, t, ps_peek_and_expect(ps, TOK_IDENT)) {
-        C_Identifier id = C_Identifier_new(t->pos, as_dupe(&t->data.string));
-        C_Expr res = C_Expr_new_identifier(id);
-        return HAVE_EXPR(res);
+// consumes a token of kind `kind`, or reports that `what` was expected there.
+static bool ps_expect(Parser* ps, TokenKind kind, const char* what) {
+    if (ps_check(ps, kind)) {
+        ps->cur++;
+        return true;
     }
-    else {
-        return NO_EXPR;
-    }
-}
 
-static char resolve_escape(char ch) {
-    switch (ch) {
-        case 'a': {
-            return '\a';
-        } break;
-        case 'b': {
-            return '\b';
-        } break;
-        case 'e': {
-            return '\033';
-        } break;
-        case 'n': {
-            return '\n';
-        } break;
-        case 'r': {
-            return '\r';
-        } break;
-        case 't': {
-            return '\t';
-        } break;
-        case '\\': {
-            return '\\';
-        } break;
-        case '\'': {
-            return '\'';
-        } break;
-        case '"': {
-            return '\"';
-        } break;
-        default: return -1;
-    }
+    ps_diag_expected(ps, what);
+    return false;
 }
 
-static bool is_int(a_string* s) {
-    if (!isdigit(as_first(s)))
-        return false;
+static void ps_diag_and_skip(Parser* ps, const char* format, ...);
 
-    char ch;
-    for (usize i = 1; i < s->len; ++i) {
-        ch = as_at(s, i);
-        if (!isdigit(ch) && ch != '_')
-            return false;
-    }
+static void ps_consume_newlines(Parser* ps) {
+    while (ps_has(ps, ps->cur) && ps_at(ps, ps->cur).kind == TOK_NEWLINE)
+        ps->cur++;
 
-    return true;
+    if (!ps_has(ps, ps->cur))
+        ps->eof = true;
 }
 
-static bool is_float(a_string* s) {
-    if (!isdigit(as_first(s)) && as_first(s) != '.')
-        return false;
-
-    if (is_int(s))
-        return false;
-
-    bool found = false;
-    char ch;
-    // starting from 0 because the first item might be a '.'
-    for (usize i = 0; i < s->len; ++i) {
-        ch = as_at(s, i);
-        if (ch == '.') {
-            if (found)
-                return false;
-            found = true;
-            continue;
-        }
-
-        if (!isdigit(ch) && ch != '_')
-            return false;
+MaybeExpr ps_ident(Parser* ps) {
+    if (!ps_check(ps, TOK_IDENT)) {
+        ps_diag_expected(ps, "an identifier");
+        return NO_EXPR;
     }
 
-    return true;
+    Token t = ps_at(ps, ps->cur++);
+    C_Identifier id = C_Identifier_new(t.pos, t.data.sym);
+    return HAVE_EXPR(C_Expr_new_identifier(ps->ast, id));
 }
 
 MaybeExpr ps_literal(Parser* ps) {
-    let_else(Token*, t, ps_peek(ps)) {
+    let_else(Token, t, ps_peek(ps)) {
         return NO_EXPR;
     }
 
-    C_Expr retval = {0};
-    a_string* s = &t->data.string;
+    C_Literal lit = {0};
+    // borrowed view of the token text, not null terminated!
+    a_string view = {0};
+    if (token_has_span(t.kind)) {
+        view = (a_string){
+            .data = (char*)token_text(&t, ps->src, ps_strings(ps)),
+            .len = t.data.span.len,
+        };
+    }
+    a_string* s = &view;
 
-    switch (t->kind) {
+    switch (t.kind) {
         case TOK_NULL: {
-            retval = C_Expr_new_literal(C_Literal_new_null(t->pos));
+            lit = C_Literal_new_null(t.pos);
             goto ok;
         } break;
         case TOK_LITERAL_CHAR: {
             if (s->len == 0) {
-                ps_diag_at(ps, t->pos,
+                ps_diag_at(ps, t.pos,
                            "not enough characters in character literal");
                 return NO_EXPR;
             }
             char ch;
             if (as_at(s, 0) == '\\') {
                 if (s->len == 1) {
-                    ps_diag_at(ps, t->pos, // FIXME: position
+                    ps_diag_at(ps, t.pos, // FIXME: position
                                "invalid escape sequence in character literal");
                     return NO_EXPR;
                 }
 
-                if ((ch = resolve_escape(as_at(s, 1))) == -1) {
-                    ps_diag_at(ps, t->pos, // FIXME: position
+                if ((ch = lx_escape(as_at(s, 1))) == -1) {
+                    ps_diag_at(ps, t.pos, // FIXME: position
                                "invalid escape in character literal");
                     return NO_EXPR;
                 }
             } else if (s->len >= 2) {
-                ps_diag_at(ps, t->pos, "character literal is too long!");
+                ps_diag_at(ps, t.pos, "character literal is too long!");
+                return NO_EXPR;
             } else {
                 ch = as_at(s, 0);
             }
-            retval = C_Expr_new_literal(C_Literal_new_char(t->pos, ch));
+            lit = C_Literal_new_char(t.pos, ch);
             goto ok;
         } break;
         case TOK_LITERAL_STRING: {
-            a_string* s = &t->data.string;
-            a_string res = as_new();
-
-            char ch;
-            for (usize i = 0; i < s->len; ++i) {
-                ch = as_at(s, i);
-                if (ch == '\\') {
-                    // last character is an escape
-                    if (i == s->len - 1) {
-                        ps_diag_at(
-                            ps, t->pos, // FIXME: pos
-                            "last character of string literal is an escape!");
-                        as_free(&res);
-                        return NO_EXPR;
-                    }
-                    ch = resolve_escape(as_at(s, ++i));
-                    if (ch == -1) {
-                        ps_diag_at(ps, t->pos, // FIXME: pos
-                                   "invalid escape sequence in string literal");
-                        as_free(&res);
-                        return NO_EXPR;
-                    }
-                }
-
-                as_append_char(&res, ch);
-            }
-
-            retval = C_Expr_new_literal(C_Literal_new_string(t->pos, res));
-            as_free(&res); // duped already
+            // the lexer has decoded the escapes already, so this is the only
+            // copy that gets made.
+            u32 off = ast_add_string(ps->ast, s->data, s->len);
+            lit = C_Literal_new_string(t.pos, off, s->len);
+            goto ok;
+        } break;
+        case TOK_LITERAL_INT: {
+            lit = C_Literal_new_int(t.pos, t.data.integer);
+            goto ok;
+        } break;
+        case TOK_LITERAL_FLOAT: {
+            lit = C_Literal_new_float(t.pos, t.data.floating);
             goto ok;
         } break;
         case TOK_LITERAL_NUMBER: {
-            if (is_float(s)) {
-                double res;
-                usize erridx = 0;
-                if ((erridx = as_to_double(s, &res)) != s->len) {
-                    if (errno == ERANGE) {
-                        ps_diag_at(ps, t->pos,
-                                   "float literal \"%s\" is either too large "
-                                   "or too small!",
-                                   s->data);
-                        return NO_EXPR;
-                    } else {
-                        Pos p = t->pos;
-                        p.col += erridx; // XXX: idk if this is even right lol
-                        p.span -= erridx;
-                        ps_diag_at(ps, p, "float literal \"%s\" is invalid!",
-                                   s->data);
-                        return NO_EXPR;
-                    }
-                }
-
-                retval = C_Expr_new_literal(C_Literal_new_float(t->pos, res));
-                goto ok;
-            } else if (is_int(s)) {
-                int64_t res;
-                usize erridx = 0;
-                if ((erridx = as_to_integer(s, &res, 0)) != s->len) {
-                    if (errno == ERANGE) {
-                        ps_diag_at(ps, t->pos,
-                                   "int literal \"%s\" is either too large or "
-                                   "too small!",
-                                   s->data);
-                        return NO_EXPR;
-                    } else {
-                        Pos p = t->pos;
-                        p.col += erridx;
-                        p.span -= erridx;
-                        ps_diag_at(ps, p, "int literal \"%s\" is invalid!",
-                                   s->data);
-                        return NO_EXPR;
-                    }
-                }
-
-                retval = C_Expr_new_literal(C_Literal_new_int(t->pos, res));
-                goto ok;
+            // the lexer could not make a value out of it
+            if (memchr(s->data, '.', s->len)) {
+                ps_diag_at(ps, t.pos,
+                           "float literal \"%.*s\" is either too large or "
+                           "too small!",
+                           (int)s->len, s->data);
+            } else if (as_first(s) == '0' && (memchr(s->data, '8', s->len) ||
+                                               memchr(s->data, '9', s->len))) {
+                ps_diag_at(ps, t.pos, "int literal \"%.*s\" is invalid!",
+                           (int)s->len, s->data);
             } else {
-                ps_diag_at(ps, t->pos, "found invalid number literal \"%s\"",
-                           s->data);
-                return NO_EXPR;
+                ps_diag_at(ps, t.pos,
+                           "int literal \"%.*s\" is either too large or too "
+                           "small!",
+                           (int)s->len, s->data);
             }
+            return NO_EXPR;
         } break;
         case TOK_LITERAL_BOOLEAN: {
-            retval =
-                C_Expr_new_literal(C_Literal_new_bool(t->pos, t->data.boolean));
+            lit = C_Literal_new_bool(t.pos, t.data.boolean);
             goto ok;
         } break;
         default: return NO_EXPR;
     }
 ok:
-    return HAVE_EXPR(retval);
+    ps->cur++;
+    return HAVE_EXPR(C_Expr_new_literal(ps->ast, lit));
+}
+
+AV_DECL(C_ExprId, ExprList)
+AV_DECL(C_BlockItem, BlockItems)
+AV_DECL(C_If_Branch, IfBranches)
+
+// how tightly an operator holds on to its operands, loosest first.
+typedef enum {
+    PS_BP_NONE = 0, // not an operator
+    PS_BP_ASSIGN,
+    PS_BP_OR,
+    PS_BP_AND,
+    PS_BP_EQUALITY,
+    PS_BP_COMPARISON,
+    PS_BP_SHIFT,
+    PS_BP_TERM,
+    PS_BP_FACTOR,
+    PS_BP_UNARY,
+    PS_BP_POW,
+    PS_BP_POSTFIX,
+} PsBindingPower;
+
+typedef enum {
+    PS_INFIX_BINARY = 0,
+    PS_INFIX_ASSIGN,
+    PS_INFIX_COMPOUND_ASSIGN,
+    PS_INFIX_CALL,
+    PS_INFIX_INDEX,
+} PsInfixKind;
+
+// what a token does when it comes after an operand. the right operand is
+// parsed with binding power `right`: one more than `left` makes the operator
+// left associative, the same makes it right associative.
+typedef struct {
+    PsInfixKind kind;
+    u8 left;
+    u8 right;
+    C_BinaryOp op; // for binary operators and compound assignments
+} PsInfix;
+
+#define PS_LEFT(bp, o)  {PS_INFIX_BINARY, bp, bp + 1, o}
+#define PS_RIGHT(bp, o) {PS_INFIX_BINARY, bp, bp, o}
+
+static const PsInfix PS_INFIX[TOK_DIV_ASSIGN + 1] = {
+    [TOK_ASSIGN] = {PS_INFIX_ASSIGN, PS_BP_ASSIGN, PS_BP_ASSIGN, 0},
+    [TOK_ADD_ASSIGN] = {PS_INFIX_COMPOUND_ASSIGN, PS_BP_ASSIGN, PS_BP_ASSIGN,
+                        C_BINARYOP_ADD},
+    [TOK_SUB_ASSIGN] = {PS_INFIX_COMPOUND_ASSIGN, PS_BP_ASSIGN, PS_BP_ASSIGN,
+                        C_BINARYOP_SUB},
+    [TOK_MUL_ASSIGN] = {PS_INFIX_COMPOUND_ASSIGN, PS_BP_ASSIGN, PS_BP_ASSIGN,
+                        C_BINARYOP_MUL},
+    [TOK_DIV_ASSIGN] = {PS_INFIX_COMPOUND_ASSIGN, PS_BP_ASSIGN, PS_BP_ASSIGN,
+                        C_BINARYOP_DIV},
+
+    [TOK_OR] = PS_LEFT(PS_BP_OR, C_BINARYOP_OR),
+    [TOK_AND] = PS_LEFT(PS_BP_AND, C_BINARYOP_AND),
+    [TOK_EQ] = PS_LEFT(PS_BP_EQUALITY, C_BINARYOP_EQ),
+    [TOK_NEQ] = PS_LEFT(PS_BP_EQUALITY, C_BINARYOP_NEQ),
+    [TOK_LT] = PS_LEFT(PS_BP_COMPARISON, C_BINARYOP_LT),
+    [TOK_GT] = PS_LEFT(PS_BP_COMPARISON, C_BINARYOP_GT),
+    [TOK_LEQ] = PS_LEFT(PS_BP_COMPARISON, C_BINARYOP_LEQ),
+    [TOK_GEQ] = PS_LEFT(PS_BP_COMPARISON, C_BINARYOP_GEQ),
+    [TOK_SHL] = PS_LEFT(PS_BP_SHIFT, C_BINARYOP_SHL),
+    [TOK_SHR] = PS_LEFT(PS_BP_SHIFT, C_BINARYOP_SHR),
+    [TOK_ADD] = PS_LEFT(PS_BP_TERM, C_BINARYOP_ADD),
+    [TOK_SUB] = PS_LEFT(PS_BP_TERM, C_BINARYOP_SUB),
+    [TOK_MUL] = PS_LEFT(PS_BP_FACTOR, C_BINARYOP_MUL),
+    [TOK_DIV] = PS_LEFT(PS_BP_FACTOR, C_BINARYOP_DIV),
+    [TOK_PERCENT] = PS_LEFT(PS_BP_FACTOR, C_BINARYOP_MOD),
+    [TOK_CARET] = PS_RIGHT(PS_BP_POW, C_BINARYOP_POW),
+
+    [TOK_LPAREN] = {PS_INFIX_CALL, PS_BP_POSTFIX, 0, 0},
+    [TOK_LBRACKET] = {PS_INFIX_INDEX, PS_BP_POSTFIX, 0, 0},
+};
+
+static MaybeExpr ps_expr_bp(Parser* ps, u8 min_bp);
+
+// lists are built up in a vector, and only go in their pool once they are
+// done, so that they end up in one piece.
+#define ps_keep(ps, pool, v) ast_push(&(ps)->ast->pool, (v).data, (v).len)
+
+static MaybeExpr ps_grouping(Parser* ps) {
+    Token t = ps_at(ps, ps->cur++);
+
+    ps_consume_newlines(ps);
+    MaybeExpr inner = ps_expr(ps);
+    if (!inner.have)
+        return NO_EXPR;
+
+    ps_consume_newlines(ps);
+    if (!ps_expect(ps, TOK_RPAREN, "\")\""))
+        return NO_EXPR;
+
+    C_UnaryExpr e = C_UnaryExpr_new(t.pos, C_UNARYOP_GROUPING, inner.data);
+    return HAVE_EXPR(C_Expr_new_unary(ps->ast, e));
+}
+
+// if cond [then] block {else if cond [then] block} [else block] end
+static MaybeExpr ps_if(Parser* ps) {
+    Token t = ps_at(ps, ps->cur++);
+    IfBranches branches = {0};
+    C_If_BranchKind kind = C_IF_PRIMARY;
+    Pos pos = t.pos;
+
+    for (;;) {
+        MaybeExpr cond = ps_expr(ps);
+        if (!cond.have)
+            goto fail;
+
+        ps_check_and_consume(ps, TOK_THEN);
+
+        MaybeBlock block = ps_block(ps);
+        if (!block.have)
+            goto fail;
+
+        C_If_Branch b;
+        if (kind == C_IF_PRIMARY)
+            b = C_If_Branch_new_primary(pos, cond.data, block.data);
+        else
+            b = C_If_Branch_new_elseif(pos, cond.data, block.data);
+        av_append(&branches, b);
+
+        if (!ps_check(ps, TOK_ELSE))
+            break;
+        pos = ps_at(ps, ps->cur++).pos;
+
+        if (!ps_check(ps, TOK_IF)) {
+            MaybeBlock rest = ps_block(ps);
+            if (!rest.have)
+                goto fail;
+            av_append(&branches, C_If_Branch_new_else(pos, rest.data));
+            break;
+        }
+        ps->cur++;
+        kind = C_IF_ELSEIF;
+    }
+
+    if (!ps_expect(ps, TOK_END, "\"end\""))
+        goto fail;
+
+    C_If res =
+        C_If_new(t.pos, ps_keep(ps, branches, branches), branches.len);
+    av_free(&branches);
+    return HAVE_EXPR(C_Expr_new_if(ps->ast, res));
+
+fail:
+    av_free(&branches);
+    return NO_EXPR;
+}
+
+static MaybeExpr ps_primary(Parser* ps) {
+    if (!ps_has(ps, ps->cur)) {
+        ps->eof = true;
+        return NO_EXPR;
+    }
+
+    switch (ps_at(ps, ps->cur).kind) {
+        case TOK_IDENT: return ps_ident(ps);
+        case TOK_NULL:
+        case TOK_LITERAL_STRING:
+        case TOK_LITERAL_CHAR:
+        case TOK_LITERAL_NUMBER:
+        case TOK_LITERAL_BOOLEAN:
+        case TOK_LITERAL_INT:
+        case TOK_LITERAL_FLOAT: return ps_literal(ps);
+        case TOK_LPAREN: return ps_grouping(ps);
+        case TOK_IF: return ps_if(ps);
+        default: {
+            ps_diag_expected(ps, "an expression");
+            return NO_EXPR;
+        } break;
+    }
 }
 
 MaybeExpr ps_unary_expr(Parser* ps) {
+    C_UnaryOp op;
+    if (ps_check(ps, TOK_SUB))
+        op = C_UNARYOP_NEGATION;
+    else if (ps_check(ps, TOK_NOT))
+        op = C_UNARYOP_NOT;
+    else
+        return ps_primary(ps);
+
+    Token t = ps_at(ps, ps->cur++);
+    MaybeExpr inner = ps_expr_bp(ps, PS_BP_UNARY);
+    if (!inner.have)
+        return NO_EXPR;
+
+    C_UnaryExpr e = C_UnaryExpr_new(t.pos, op, inner.data);
+    return HAVE_EXPR(C_Expr_new_unary(ps->ast, e));
+}
+
+// `callee(args...)`, with the "(" consumed already.
+static MaybeExpr ps_call(Parser* ps, C_ExprId callee, Token lparen) {
+    if (C_EXPR_KIND(callee) != C_EXPR_IDENTIFIER) {
+        ps_diag_at(ps, lparen.pos, "only a function name can be called");
+        return NO_EXPR;
+    }
+
+    ExprList args = {0};
+    for (;;) {
+        ps_consume_newlines(ps);
+        if (args.len == 0 && ps_check(ps, TOK_RPAREN))
+            break;
+
+        MaybeExpr arg = ps_expr(ps);
+        if (!arg.have)
+            goto fail;
+        av_append(&args, arg.data);
+
+        ps_consume_newlines(ps);
+        if (!ps_check(ps, TOK_COMMA))
+            break;
+        ps->cur++;
+    }
+
+    if (!ps_expect(ps, TOK_RPAREN, "\")\""))
+        goto fail;
+
+    C_Identifier id = *AST_EXPR(ps->ast, idents, callee);
+    C_FnCall res =
+        C_FnCall_new(id.pos, id, ps_keep(ps, expr_lists, args), args.len);
+    av_free(&args);
+    return HAVE_EXPR(C_Expr_new_fncall(ps->ast, res));
+
+fail:
+    av_free(&args);
     return NO_EXPR;
 }
 
+// `target[index]`, with the "[" consumed already.
+static MaybeExpr ps_index(Parser* ps, C_ExprId target, Token lbracket) {
+    ps_consume_newlines(ps);
+    MaybeExpr index = ps_expr(ps);
+    if (!index.have)
+        return NO_EXPR;
+
+    ps_consume_newlines(ps);
+    if (!ps_expect(ps, TOK_RBRACKET, "\"]\""))
+        return NO_EXPR;
+
+    C_ArrayIndex res = C_ArrayIndex_new(lbracket.pos, target, index.data);
+    return HAVE_EXPR(C_Expr_new_array_index(ps->ast, res));
+}
+
+// `target = value` or `target op= value`, with the operator consumed already.
+static MaybeExpr ps_assign(Parser* ps, C_ExprId target, Token op,
+                           const PsInfix* in) {
+    C_ExprKind kind = C_EXPR_KIND(target);
+    if (kind != C_EXPR_IDENTIFIER && kind != C_EXPR_ARRAY_INDEX) {
+        ps_diag_at(ps, op.pos,
+                   "can only assign to a variable or an array element");
+        return NO_EXPR;
+    }
+
+    ps_consume_newlines(ps);
+    MaybeExpr value = ps_expr_bp(ps, in->right);
+    if (!value.have)
+        return NO_EXPR;
+
+    Pos pos;
+    if (kind == C_EXPR_IDENTIFIER)
+        pos = AST_EXPR(ps->ast, idents, target)->pos;
+    else
+        pos = AST_EXPR(ps->ast, indexes, target)->pos;
+    C_Lvalue lv = C_Lvalue_new(pos, target);
+
+    C_Assign res;
+    if (in->kind == PS_INFIX_COMPOUND_ASSIGN)
+        res = C_Assign_new_compound(op.pos, in->op, lv, value.data);
+    else
+        res = C_Assign_new(op.pos, lv, value.data);
+    return HAVE_EXPR(C_Expr_new_assign(ps->ast, res));
+}
+
+// precedence climbing: parses an operand, then keeps taking operators for as
+// long as they bind at least as tightly as `min_bp`. every token is looked at
+// once, so there is no backtracking.
+static MaybeExpr ps_expr_bp(Parser* ps, u8 min_bp) {
+    MaybeExpr lhs = ps_unary_expr(ps);
+
+    while (lhs.have && ps_has(ps, ps->cur)) {
+        Token op = ps_at(ps, ps->cur);
+        const PsInfix* in = &PS_INFIX[op.kind];
+        if (in->left == PS_BP_NONE || in->left < min_bp)
+            break;
+        ps->cur++;
+
+        switch (in->kind) {
+            case PS_INFIX_BINARY: {
+                ps_consume_newlines(ps);
+                MaybeExpr rhs = ps_expr_bp(ps, in->right);
+                if (!rhs.have)
+                    return NO_EXPR;
+
+                C_BinaryExpr e =
+                    C_BinaryExpr_new(op.pos, in->op, lhs.data, rhs.data);
+                lhs = HAVE_EXPR(C_Expr_new_binary(ps->ast, e));
+            } break;
+            case PS_INFIX_ASSIGN:
+            case PS_INFIX_COMPOUND_ASSIGN: {
+                lhs = ps_assign(ps, lhs.data, op, in);
+            } break;
+            case PS_INFIX_CALL: {
+                lhs = ps_call(ps, lhs.data, op);
+            } break;
+            case PS_INFIX_INDEX: {
+                lhs = ps_index(ps, lhs.data, op);
+            } break;
+        }
+    }
+
+    return lhs;
+}
+
 MaybeExpr ps_expr(Parser* ps) {
-    return ps_literal(ps);
+    return ps_expr_bp(ps, PS_BP_ASSIGN);
+}
+
+// `include "path"`. `at` is how many items of the file come before it.
+static bool ps_include(Parser* ps, u32 at) {
+    Token t = ps_at(ps, ps->cur++);
+    if (!ps_check(ps, TOK_LITERAL_STRING)) {
+        ps_diag_expected(ps, "the name of a file");
+        return false;
+    }
+
+    Token name = ps_at(ps, ps->cur++);
+    const char* path = token_text(&name, ps->src, ps_strings(ps));
+    u32 len = name.data.span.len;
+    u32 off = ast_add_string(ps->ast, path, len);
+
+    C_Include inc = C_Include_new(t.pos, off, len, at);
+    ast_push(&ps->ast->includes, &inc, 1);
+    return true;
+}
+
+// expressions, one to a line, up to the end of the file. unless `top` is set,
+// an "else" or an "end" finishes the block as well, and is left for the
+// caller. includes are only allowed at the top.
+static MaybeBlock ps_lines(Parser* ps, bool top) {
+    BlockItems items = {0};
+
+    for (;;) {
+        ps_consume_newlines(ps);
+        if (!ps_has(ps, ps->cur))
+            goto fail;
+
+        TokenKind k = ps_at(ps, ps->cur).kind;
+        if (k == TOK_EOF || (!top && (k == TOK_ELSE || k == TOK_END)))
+            break;
+
+        if (top && k == TOK_INCLUDE) {
+            if (!ps_include(ps, items.len))
+                goto fail;
+        } else {
+            MaybeExpr e = ps_expr(ps);
+            if (!e.have)
+                goto fail;
+            av_append(&items, C_BlockItem_new_expr(e.data));
+        }
+
+        if (!ps_has(ps, ps->cur))
+            goto fail;
+
+        k = ps_at(ps, ps->cur).kind;
+        if (k != TOK_NEWLINE && k != TOK_EOF &&
+            (top || (k != TOK_ELSE && k != TOK_END))) {
+            ps_diag_expected(ps, "a new line");
+            goto fail;
+        }
+    }
+
+    C_Block res = C_Block_new(ps_keep(ps, items, items), items.len);
+    av_free(&items);
+    return HAVE_BLOCK(res);
+
+fail:
+    av_free(&items);
+    return NO_BLOCK;
+}
+
+MaybeBlock ps_block(Parser* ps) {
+    return ps_lines(ps, false);
 }
 
-C_Block ps_block(Parser* ps) {
-    return C_Block_new(NULL, 0);
+MaybeBlock ps_file(Parser* ps) {
+    return ps_lines(ps, true);
 }
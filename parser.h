@@ -17,11 +17,26 @@
 #include "lexer.h"
 #include "lexertypes.h"
 
+// how many tokens a pulling parser keeps around. a power of two.
+#define PS_LOOKAHEAD 4
+
 typedef struct {
-    Lexer lx;
     a_string file_name;
-    Token* tokens;
-    usize tokens_len;
+    const char* src; // the buffer the tokens were lexed from
+    TokenStream toks; // borrowed, not freed by ps_free
+    LineTable lines;  // for diagnostics
+    Ast* ast;         // where the nodes go, see ast.h
+    FILE* diag;       // where diagnostics go, stderr unless changed
+
+    // a pulling parser lexes as it goes instead of reading `toks`. token `i`
+    // is in ring[i % PS_LOOKAHEAD] for as long as it is one of the last few
+    // that were pulled.
+    bool pull;
+    Lexer lx;
+    Token ring[PS_LOOKAHEAD];
+    u32 pulled; // how many tokens have been pulled so far
+    bool lx_done; // the lexer is at the end, or failed
+
     // state
     u32 error_count;
     u32 cur;
@@ -35,7 +50,7 @@ typedef struct {
         bool have;                                                             \
     } name
 
-DECL_MAYBE(Token*, MaybeToken);
+DECL_MAYBE(Token, MaybeToken);
 
 #define HAVE_TOKEN(tok)                                                        \
     (MaybeToken) {                                                             \
@@ -46,7 +61,7 @@ DECL_MAYBE(Token*, MaybeToken);
         .have = false                                                          \
     }
 
-DECL_MAYBE(C_Expr, MaybeExpr);
+DECL_MAYBE(C_ExprId, MaybeExpr);
 
 #define HAVE_EXPR(exp)                                                         \
     (MaybeExpr) {                                                              \
@@ -57,11 +72,36 @@ DECL_MAYBE(C_Expr, MaybeExpr);
         .have = false                                                          \
     }
 
-Parser ps_new(a_string file_name, Token* toks, usize len);
+DECL_MAYBE(C_Block, MaybeBlock);
+
+#define HAVE_BLOCK(blk)                                                        \
+    (MaybeBlock) {                                                             \
+        .have = true, .data = blk                                              \
+    }
+#define NO_BLOCK                                                               \
+    (MaybeBlock) {                                                             \
+        .have = false                                                          \
+    }
+
+// parses a token stream that was lexed from `src` in full. the nodes go in
+// `ast`, which belongs to the caller and can outlive the parser.
+Parser ps_new(a_string file_name, const char* src, usize src_len,
+              const TokenStream* toks, Ast* ast);
+// parses `src` while it is being lexed, so there is never more than a few
+// tokens in memory. identifiers are interned into `syms`. the parser can only
+// look PS_LOOKAHEAD - 2 tokens ahead, and one back.
+Parser ps_new_pull(a_string file_name, const char* src, usize src_len,
+                   SymbolTable* syms, Ast* ast);
 void ps_free(Parser* ps);
 MaybeExpr ps_expr(Parser* ps);
-C_Block ps_block(Parser* ps);
+MaybeBlock ps_block(Parser* ps);
+// parses a whole file, up to the end. its includes go in the include pool.
+MaybeBlock ps_file(Parser* ps);
 
 void ps_diag(Parser* ps, const char* format, ...);
+void ps_diag_at(Parser* ps, Pos pos, const char* format, ...);
+// reports an error the same way, for when there is no parser at hand.
+void ps_report(FILE* fp, const a_string* file_name, LineTable* lines, Pos pos,
+               const char* format, ...);
 
 #endif // _PARSER_H
@@ -0,0 +1,507 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _XOPEN_SOURCE 700 // realpath
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "a_string.h"
+#include "a_vector.h"
+#include "ast.h"
+#include "common.h"
+#include "modfile.h"
+#include "parser.h"
+#include "program.h"
+#include "scan.h"
+#include "source.h"
+#include "symtab.h"
+
+typedef struct {
+    Program* pg;
+    Modules queue; // waiting to be parsed, taken from the back
+    u32 pending;   // queued, or being parsed
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake; // something was queued, or everything is done
+} PgJobs;
+
+// an include the scan found.
+typedef struct {
+    u32 off; // of the "include"
+    const char* path; // as written, not null terminated
+    u32 len;
+
+    Module* m; // null if it could not be loaded
+    int err;
+} PgInclude;
+
+AV_DECL(PgInclude, PgIncludes)
+
+static Module* pg_module_new(a_string name, a_string path, SourceFile src,
+                             u64 hash) {
+    Module* m = calloc(1, sizeof(Module));
+    check_alloc(m);
+
+    *m = (Module){
+        .name = name,
+        .path = path,
+        .src = src,
+        .hash = hash,
+        .syms = sym_new(),
+        .ast = ast_new(),
+    };
+    return m;
+}
+
+static void pg_module_free(Module* m) {
+    as_free(&m->name);
+    as_free(&m->path);
+    sf_close(&m->src);
+    sym_free(&m->syms);
+    if (m->mf.map != NULL)
+        mf_close(&m->mf);
+    else
+        ast_free(&m->ast);
+    av_free(&m->includes);
+    free(m->diags);
+    free(m);
+}
+
+// with the lock held.
+static void pg_queue(PgJobs* j, Module* m) {
+    m->queued = true;
+    av_append(&j->queue, m);
+    j->pending++;
+    pthread_cond_signal(&j->wake);
+}
+
+static void pg_drop(PgJobs* j, PgInclude* inc) {
+    if (inc->m == NULL)
+        return;
+
+    pthread_mutex_lock(&j->lock);
+    inc->m->wanted--;
+    pthread_mutex_unlock(&j->lock);
+}
+
+// puts a new module in the cache, in the place of any older one for the same
+// path, with the lock held.
+static void pg_cache(Program* pg, Module* m) {
+    u32 id = sym_intern(&pg->paths, m->path.data, m->path.len);
+    while (pg->cache.len <= id)
+        av_append(&pg->cache, NULL);
+    pg->cache.data[id] = m;
+    av_append(&pg->all, m);
+}
+
+// `path` as seen from the file `from`: relative to the directory it is in,
+// unless it is absolute.
+static a_string pg_join(const a_string* from, const char* path, u32 len) {
+    u32 dir = 0;
+    if (path[0] != '/') {
+        for (u32 i = from->len; i > 0; i--) {
+            if (from->data[i - 1] == '/') {
+                dir = i;
+                break;
+            }
+        }
+    }
+
+    a_string res = as_with_capacity(dir + len + 1);
+    memcpy(res.data, from->data, dir);
+    memcpy(res.data + dir, path, len);
+    res.len = dir + len;
+    res.data[res.len] = '\0';
+    return res;
+}
+
+// the module for a file that `from` includes. it comes from the cache if the
+// file has not changed since it was loaded, and is loaded and queued up
+// otherwise. returns null and sets errno if the file cannot be read.
+static Module* pg_open(PgJobs* j, Module* from, const char* path, u32 len) {
+    a_string name = pg_join(&from->name, path, len);
+
+    char* canon = realpath(name.data, NULL);
+    if (canon == NULL)
+        goto fail;
+
+    SourceFile src;
+    if (!sf_open(&src, canon))
+        goto fail;
+    u64 hash = sf_hash(&src);
+
+    pthread_mutex_lock(&j->lock);
+    Program* pg = j->pg;
+    u32 id = sym_intern(&pg->paths, canon, strlen(canon));
+    Module* m = (id < pg->cache.len) ? pg->cache.data[id] : NULL;
+
+    if (m != NULL && m->hash == hash) {
+        if (m->wanted++ == 0 && !m->queued)
+            pg_queue(j, m);
+        pthread_mutex_unlock(&j->lock);
+
+        sf_close(&src);
+        free(canon);
+        as_free(&name);
+        return m;
+    }
+
+    m = pg_module_new(name, astr(canon), src, hash);
+    m->wanted = 1;
+    pg_cache(pg, m);
+    pg_queue(j, m);
+    pthread_mutex_unlock(&j->lock);
+
+    free(canon);
+    return m;
+
+fail:
+    free(canon);
+    as_free(&name);
+    return NULL;
+}
+
+// finds the lines that look like `include "path"`, and opens the files. the
+// scan does not know about comments or strings that go over several lines, so
+// it can be wrong, but the parser has the last word.
+static void pg_scan(PgJobs* j, Module* m, PgIncludes* res) {
+    static const char KEYWORD[] = "include";
+    const u32 kwlen = sizeof(KEYWORD) - 1;
+    const char* src = m->src.data;
+    const char* end = src + m->src.len;
+
+    for (const char* p = src; p < end;) {
+        const char* eol = sc_find(p, end, '\n');
+        const char* s = sc_skip_blanks(p, eol);
+        p = (eol == end) ? end : eol + 1;
+
+        if ((usize)(eol - s) < kwlen + 3 || memcmp(s, KEYWORD, kwlen) != 0)
+            continue;
+
+        const char* q = sc_skip_blanks(s + kwlen, eol);
+        if (q == s + kwlen || q == eol || *q != '"')
+            continue;
+
+        // no escapes, so that the path is the same as the lexer's
+        const char* close = sc_find2(q + 1, eol, '"', '\\');
+        if (close == eol || *close != '"' || close == q + 1)
+            continue;
+
+        PgInclude inc = {
+            .off = s - src,
+            .path = q + 1,
+            .len = close - (q + 1),
+        };
+        inc.m = pg_open(j, m, inc.path, inc.len);
+        inc.err = errno;
+        av_append(res, inc);
+    }
+}
+
+static void pg_diag_include(FILE* fp, Module* m, LineTable* lines,
+                            const C_Include* inc, int err) {
+    char buf[256];
+    strerror_r(err, buf, sizeof(buf));
+    ps_report(fp, &m->name, lines, inc->pos, "could not include \"%s\": %s",
+              &m->ast.strings.data[inc->path], buf);
+}
+
+// maps in the module file for `m`, if it has an up to date one, and opens the
+// files it includes. there is no scan, as the includes are all known already.
+static bool pg_load_precompiled(PgJobs* j, Module* m, const a_string* cpath) {
+    SymbolTable syms;
+    if (!mf_load(&m->mf, cpath->data, m->hash, &m->ast, &syms, &m->body))
+        return false;
+
+    sym_free(&m->syms);
+    m->syms = syms;
+    m->ok = true;
+
+    FILE* diag = open_memstream(&m->diags, &m->diags_len);
+    check_alloc(diag);
+    LineTable lines = {0};
+    bool have_lines = false;
+
+    for (u32 i = 0; i < m->ast.includes.len; i++) {
+        const C_Include* inc = &m->ast.includes.data[i];
+        Module* found = pg_open(j, m, &m->ast.strings.data[inc->path],
+                                inc->path_len);
+        if (found == NULL) {
+            int err = errno;
+            if (!have_lines) {
+                lines = lt_new(m->src.data, m->src.len);
+                have_lines = true;
+            }
+            pg_diag_include(diag, m, &lines, inc, err);
+            m->ok = false;
+        }
+        av_append(&m->includes, found);
+    }
+
+    if (have_lines)
+        lt_free(&lines);
+    fclose(diag);
+    return true;
+}
+
+// scans and parses a file, and puts the files it includes in the queue.
+// returns whether it parsed, whether or not its includes could be loaded.
+static bool pg_parse_source(PgJobs* j, Module* m) {
+    PgIncludes scanned = {0};
+    pg_scan(j, m, &scanned);
+
+    // the parser stops at the first error, so that comes after every include
+    // it found, and is held back until they have been reported.
+    char* errs;
+    usize errs_len;
+    FILE* diag = open_memstream(&m->diags, &m->diags_len);
+    FILE* parse_diag = open_memstream(&errs, &errs_len);
+    check_alloc(diag);
+    check_alloc(parse_diag);
+
+    Parser ps = ps_new_pull(as_dupe(&m->name), m->src.data, m->src.len,
+                            &m->syms, &m->ast);
+    ps.diag = parse_diag;
+
+    MaybeBlock body = ps_file(&ps);
+    m->ok = body.have;
+    if (body.have)
+        m->body = body.data;
+
+    fclose(parse_diag);
+
+    // both lists are in the order of the file, so they are matched up as they
+    // go. the scan's extras are dropped, and what it missed is opened now.
+    u32 k = 0;
+    for (u32 i = 0; i < m->ast.includes.len; i++) {
+        const C_Include* inc = &m->ast.includes.data[i];
+        const char* path = &m->ast.strings.data[inc->path];
+
+        while (k < scanned.len && scanned.data[k].off < inc->pos.off)
+            pg_drop(j, &scanned.data[k++]);
+
+        PgInclude found;
+        if (k < scanned.len && scanned.data[k].off == inc->pos.off &&
+            scanned.data[k].len == inc->path_len &&
+            !memcmp(scanned.data[k].path, path, inc->path_len)) {
+            found = scanned.data[k++];
+        } else {
+            found.m = pg_open(j, m, path, inc->path_len);
+            found.err = errno;
+        }
+
+        if (found.m == NULL) {
+            pg_diag_include(diag, m, &ps.lines, inc, found.err);
+            m->ok = false;
+        }
+        av_append(&m->includes, found.m);
+    }
+    while (k < scanned.len)
+        pg_drop(j, &scanned.data[k++]);
+
+    fwrite(errs, 1, errs_len, diag);
+    free(errs);
+    ps_free(&ps);
+    fclose(diag);
+    av_free(&scanned);
+    return body.have;
+}
+
+// loads a module, from its module file if it can. a file that has to be
+// parsed gets a module file if asked for, unless it has errors. one that
+// cannot be written is not a problem, the file is just parsed again next time.
+static void pg_parse(PgJobs* j, Module* m) {
+    PgModfiles modfiles = j->pg->modfiles;
+    if (modfiles == PG_MODFILES_OFF || m->path.len == 0) {
+        pg_parse_source(j, m);
+        return;
+    }
+
+    a_string cpath = mf_path(&m->path);
+    if (!pg_load_precompiled(j, m, &cpath) && pg_parse_source(j, m) &&
+        modfiles == PG_MODFILES_WRITE)
+        mf_save(cpath.data, m->hash, &m->ast, &m->syms, m->body);
+    as_free(&cpath);
+}
+
+// each thread parses modules until there are none left, and none are being
+// parsed that could queue up more.
+static void* pg_worker(void* arg) {
+    PgJobs* j = arg;
+
+    pthread_mutex_lock(&j->lock);
+    for (;;) {
+        while (j->queue.len == 0 && j->pending != 0)
+            pthread_cond_wait(&j->wake, &j->lock);
+        if (j->queue.len == 0)
+            break;
+
+        Module* m = j->queue.data[--j->queue.len];
+        if (m->wanted == 0) {
+            // it goes back in the queue if it is wanted after all
+            m->queued = false;
+        } else {
+            pthread_mutex_unlock(&j->lock);
+            pg_parse(j, m);
+            pthread_mutex_lock(&j->lock);
+        }
+
+        if (--j->pending == 0)
+            pthread_cond_broadcast(&j->wake);
+    }
+    pthread_mutex_unlock(&j->lock);
+
+    return NULL;
+}
+
+static u32 pg_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n < 1) ? 1 : (u32)n;
+}
+
+// parses everything from `main` on, on up to `jobs` threads, the calling one
+// included. if a thread cannot be started, the others pick up its share.
+static void pg_run(Program* pg, u32 jobs) {
+    PgJobs j = {.pg = pg};
+    pthread_mutex_init(&j.lock, NULL);
+    pthread_cond_init(&j.wake, NULL);
+    pg_queue(&j, pg->main);
+
+    pthread_t* threads = calloc(jobs, sizeof(pthread_t));
+    check_alloc(threads);
+
+    u32 started = 0;
+    for (; started + 1 < jobs; started++) {
+        if (pthread_create(&threads[started], NULL, pg_worker, &j) != 0)
+            break;
+    }
+    pg_worker(&j);
+    for (u32 i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    av_free(&j.queue);
+    pthread_cond_destroy(&j.wake);
+    pthread_mutex_destroy(&j.lock);
+}
+
+enum {
+    PG_UNVISITED = 0,
+    PG_VISITING, // it is one of the files being included, so far up
+    PG_VISITED,
+};
+
+// prints the diagnostics of `m` and of everything it includes, each module
+// once, and looks for files that include themselves on the way.
+static void pg_report(Program* pg, Module* m) {
+    m->visit = PG_VISITING;
+    fwrite(m->diags, 1, m->diags_len, stderr);
+    if (!m->ok)
+        pg->ok = false;
+
+    for (u32 i = 0; i < m->includes.len; i++) {
+        Module* inc = m->includes.data[i];
+        if (inc == NULL)
+            continue;
+
+        if (inc->visit == PG_VISITING) {
+            const C_Include* at = &m->ast.includes.data[i];
+            LineTable lines = lt_new(m->src.data, m->src.len);
+            ps_report(stderr, &m->name, &lines, at->pos,
+                      "could not include \"%s\": it includes itself",
+                      &m->ast.strings.data[at->path]);
+            lt_free(&lines);
+            pg->ok = false;
+        } else if (inc->visit == PG_UNVISITED) {
+            pg_report(pg, inc);
+        }
+    }
+
+    m->visit = PG_VISITED;
+}
+
+// adds the top level of `m` to the program, with the files it includes in
+// their places unless they are in already, and moves its identifiers over to
+// the program's table.
+static void pg_splice(Program* pg, Module* m) {
+    m->spliced = true;
+
+    u32* remap = malloc(sizeof(u32) * (m->syms.len + 1));
+    check_alloc(remap);
+    for (u32 i = 0; i < m->syms.len; i++)
+        remap[i] = sym_intern(&pg->syms, sym_name(&m->syms, i),
+                              sym_len(&m->syms, i));
+    ast_remap_syms(&m->ast, remap);
+    free(remap);
+    sym_free(&m->syms);
+
+    u32 inc = 0;
+    for (u32 i = 0; i <= m->body.len; i++) {
+        for (; inc < m->ast.includes.len && m->ast.includes.data[inc].at == i;
+             inc++) {
+            if (!m->includes.data[inc]->spliced)
+                pg_splice(pg, m->includes.data[inc]);
+        }
+
+        if (i == m->body.len)
+            break;
+
+        const C_BlockItem* itm = &m->ast.items.data[m->body.items + i];
+        av_append(&pg->items, ((ProgramItem){m, itm->expr}));
+    }
+}
+
+Program pg_load(a_string name, SourceFile src, u32 jobs,
+                PgModfiles modfiles) {
+    if (jobs == 0)
+        jobs = pg_cpu_count();
+
+    // includes of a main file that is not a file are relative to the current
+    // directory
+    char* canon = realpath(name.data, NULL);
+    a_string path = (canon != NULL) ? astr(canon) : as_new();
+    free(canon);
+
+    Program pg = {
+        .main = pg_module_new(name, path, src, sf_hash(&src)),
+        .paths = sym_new(),
+        .syms = sym_new(),
+        .modfiles = modfiles,
+        .ok = true,
+    };
+    pg.main->wanted = 1;
+    if (pg.main->path.len != 0)
+        pg_cache(&pg, pg.main);
+    else
+        av_append(&pg.all, pg.main);
+    pg_run(&pg, jobs);
+
+    pg_report(&pg, pg.main);
+    if (pg.ok)
+        pg_splice(&pg, pg.main);
+    return pg;
+}
+
+void pg_free(Program* pg) {
+    for (u32 i = 0; i < pg->all.len; i++)
+        pg_module_free(pg->all.data[i]);
+    av_free(&pg->all);
+    sym_free(&pg->paths);
+    av_free(&pg->cache);
+    av_free(&pg->items);
+    sym_free(&pg->syms);
+    *pg = (Program){0};
+}
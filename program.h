@@ -0,0 +1,106 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _PROGRAM_H
+#define _PROGRAM_H
+
+#include "a_string.h"
+#include "a_vector.h"
+#include "ast.h"
+#include "common.h"
+#include "modfile.h"
+#include "source.h"
+#include "symtab.h"
+
+// a program is a main file and everything it includes, however deep. every
+// file is lexed and parsed by a task of its own, and the tasks are run side by
+// side on a pool of threads. the includes of a file are picked out with a
+// quick scan before it is parsed, so the files it includes are being worked on
+// while it is.
+//
+// a file that is included in more than one place is loaded once, and its
+// module is shared by every file that includes it. modules are cached by
+// their canonical path and the hash of their contents, so a file is only
+// parsed again if it has changed in the meantime.
+//
+// a parsed file can also be saved next to its source as a module file (see
+// modfile.h), which later loads map in instead of parsing the file again.
+
+// what is done with module files.
+typedef enum {
+    PG_MODFILES_OFF = 0,
+    PG_MODFILES_READ,  // up to date ones are used instead of the source
+    PG_MODFILES_WRITE, // and every file that has to be parsed gets one
+} PgModfiles;
+
+struct Module;
+AV_DECL(struct Module*, Modules)
+
+typedef struct Module {
+    a_string name; // as given, or as included, for diagnostics
+    a_string path; // canonical. empty for a main file that is not a file
+    SourceFile src;
+    u64 hash; // of `src`, see sf_hash
+    SymbolTable syms; // until the program is put together
+    Ast ast;
+    ModuleFile mf; // that `ast` is in, if it was loaded from one
+    C_Block body;
+    Modules includes; // one for each in the include pool, null if it failed
+
+    // diagnostics go in here as the file is worked on, and are printed once
+    // every file is done.
+    char* diags;
+    usize diags_len;
+
+    // how many includes want it, counting the scan's guesses. it is only
+    // parsed if some still do when it comes up in the queue.
+    u32 wanted;
+    bool queued; // or parsed already
+    u8 visit;    // how far pg_report has got with it
+    bool spliced;
+    bool ok;
+} Module;
+
+// a top level expression, and the tree it is in.
+typedef struct {
+    Module* module;
+    C_ExprId expr;
+} ProgramItem;
+
+AV_DECL(ProgramItem, ProgramItems)
+
+typedef struct {
+    Module* main;
+    Modules all; // every module that was loaded
+
+    // the module cache. cache[i] is the latest module for paths[i], which
+    // is a canonical path.
+    SymbolTable paths;
+    Modules cache;
+
+    // the top level expressions of every file, with the contents of each
+    // included file where it is first included. the identifiers in every
+    // tree are in `syms`. both are empty unless the program is ok.
+    ProgramItems items;
+    SymbolTable syms;
+    PgModfiles modfiles;
+    bool ok;
+} Program;
+
+// loads the file `name`, with contents `src`, and everything it includes,
+// on up to `jobs` threads (0 for one per cpu). both are taken over.
+//
+// diagnostics are printed to stderr when everything is done, a file's own
+// before those of the files it includes, and those in the order they are
+// first included in.
+Program pg_load(a_string name, SourceFile src, u32 jobs,
+                PgModfiles modfiles);
+void pg_free(Program* pg);
+
+#endif // _PROGRAM_H
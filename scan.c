@@ -0,0 +1,433 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "common.h"
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) &&         \
+    defined(__SSE2__)
+#define SC_SIMD
+#include <immintrin.h>
+#endif
+
+static inline bool sc_is_blank(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+static const char* sc_skip_blanks_scalar(const char* p, const char* end) {
+    while (p < end && sc_is_blank(*p))
+        p++;
+    return p;
+}
+
+static const char* sc_find2_scalar(const char* p, const char* end, char a,
+                                   char b) {
+    while (p < end && *p != a && *p != b)
+        p++;
+    return p;
+}
+
+static usize sc_count_scalar(const char* p, const char* end, char ch) {
+    usize n = 0;
+    for (; p < end; p++)
+        n += *p == ch;
+    return n;
+}
+
+// checks the characters that start before `stop`. returns the first one that
+// is not valid, with `bad` set, or else where the next character starts.
+static const char* sc_utf8_scalar(const char* p, const char* end,
+                                  const char* stop, bool* bad) {
+    // smallest code point for each length, anything less is overlong
+    static const u32 MIN[5] = {0, 0, 0x80, 0x800, 0x10000};
+
+    *bad = false;
+    while (p < stop) {
+        u8 ch = *p;
+        if (ch < 0x80) {
+            p++;
+            continue;
+        }
+
+        u32 len, cp;
+        if ((ch & 0xE0) == 0xC0) {
+            len = 2;
+            cp = ch & 0x1F;
+        } else if ((ch & 0xF0) == 0xE0) {
+            len = 3;
+            cp = ch & 0x0F;
+        } else if ((ch & 0xF8) == 0xF0) {
+            len = 4;
+            cp = ch & 0x07;
+        } else {
+            goto bad;
+        }
+
+        if ((usize)(end - p) < len)
+            goto bad;
+        for (u32 i = 1; i < len; i++) {
+            if ((p[i] & 0xC0) != 0x80)
+                goto bad;
+            cp = cp << 6 | (p[i] & 0x3F);
+        }
+
+        if (cp < MIN[len] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            goto bad;
+        p += len;
+    }
+
+    return p;
+
+bad:
+    *bad = true;
+    return p;
+}
+
+#ifdef SC_SIMD
+
+// blanks are ' ' and 9..13 except '\n'. bytes >= 0x80 compare as negative, so
+// they fall out of the range check on their own.
+
+static const char* sc_skip_blanks_sse2(const char* p, const char* end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i lo = _mm_set1_epi8('\t' - 1);
+    const __m128i hi = _mm_set1_epi8('\r' + 1);
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i range =
+            _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                     _mm_andnot_si128(_mm_cmpeq_epi8(v, nl),
+                                                      range));
+        u32 mask = ~(u32)_mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+
+    return sc_skip_blanks_scalar(p, end);
+}
+
+static const char* sc_find2_sse2(const char* p, const char* end, char a,
+                                 char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb));
+        u32 mask = (u32)_mm_movemask_epi8(hit);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+
+    return sc_find2_scalar(p, end, a, b);
+}
+
+static usize sc_count_sse2(const char* p, const char* end, char ch) {
+    const __m128i vc = _mm_set1_epi8(ch);
+    usize n = 0;
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        n += __builtin_popcount((u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vc)));
+        p += 16;
+    }
+
+    return n + sc_count_scalar(p, end, ch);
+}
+
+__attribute__((target("avx2"))) static const char*
+sc_skip_blanks_avx2(const char* p, const char* end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i lo = _mm256_set1_epi8('\t' - 1);
+    const __m256i hi = _mm256_set1_epi8('\r' + 1);
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i range =
+            _mm256_and_si256(_mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v));
+        __m256i blank = _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, space),
+            _mm256_andnot_si256(_mm256_cmpeq_epi8(v, nl), range));
+        u32 mask = ~(u32)_mm256_movemask_epi8(blank);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+
+    return sc_skip_blanks_sse2(p, end);
+}
+
+__attribute__((target("avx2"))) static const char*
+sc_find2_avx2(const char* p, const char* end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i hit =
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb));
+        u32 mask = (u32)_mm256_movemask_epi8(hit);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+
+    return sc_find2_sse2(p, end, a, b);
+}
+
+__attribute__((target("avx2,popcnt"))) static usize
+sc_count_avx2(const char* p, const char* end, char ch) {
+    const __m256i vc = _mm256_set1_epi8(ch);
+    usize n = 0;
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        n += __builtin_popcount(
+            (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vc)));
+        p += 32;
+    }
+
+    return n + sc_count_sse2(p, end, ch);
+}
+
+// only ascii is checked with vectors. as soon as a block has anything else in
+// it, the characters in that block are checked one by one.
+static const char* sc_utf8_check_sse2(const char* p, const char* end) {
+    bool bad;
+    while (p < end) {
+        while (end - p >= 16 &&
+               _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p)) == 0)
+            p += 16;
+
+        p = sc_utf8_scalar(p, end, (end - p >= 16) ? p + 16 : end, &bad);
+        if (bad)
+            return p;
+    }
+
+    return end;
+}
+
+// the lookup algorithm from Keiser and Lemire, "Validating UTF-8 In Less Than
+// One Instruction Per Byte". every error shows up in the first two bytes of a
+// sequence, so three table lookups on the nibbles of each byte and the one
+// before it find most of them. the rest is making sure that there are exactly
+// as many continuation bytes as the lead byte asks for.
+
+#define SC_TOO_SHORT   (1 << 0) // lead byte not followed by a continuation
+#define SC_TOO_LONG    (1 << 1) // continuation after ascii
+#define SC_OVERLONG_3  (1 << 2) // E0 80..9F
+#define SC_TOO_LARGE   (1 << 3) // past U+10FFFF
+#define SC_SURROGATE   (1 << 4) // ED A0..BF
+#define SC_OVERLONG_2  (1 << 5) // C0 or C1
+#define SC_TOO_LARGE_1000 (1 << 6) // F5.. 80..8F
+#define SC_OVERLONG_4  (1 << 6) // F0 80..8F
+#define SC_TWO_CONTS   (1 << 7) // continuation after continuation
+#define SC_CARRY       (SC_TOO_SHORT | SC_TOO_LONG | SC_TWO_CONTS)
+
+#define SC_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// the bytes `n` before each one in `v`, carried over from `prev`
+#define SC_PREV(v, prev, n)                                                    \
+    _mm256_alignr_epi8((v), _mm256_permute2x128_si256((prev), (v), 0x21),    \
+                       16 - (n))
+
+__attribute__((target("avx2"))) static inline __m256i
+sc_utf8_errors_avx2(__m256i v, __m256i prev) {
+    const __m256i byte_1_high = SC_TABLE(
+        // ascii
+        SC_TOO_LONG, SC_TOO_LONG, SC_TOO_LONG, SC_TOO_LONG, SC_TOO_LONG,
+        SC_TOO_LONG, SC_TOO_LONG, SC_TOO_LONG,
+        // continuation
+        (char)SC_TWO_CONTS, (char)SC_TWO_CONTS, (char)SC_TWO_CONTS,
+        (char)SC_TWO_CONTS,
+        // 1100, 1101, 1110, 1111
+        SC_TOO_SHORT | SC_OVERLONG_2, SC_TOO_SHORT,
+        SC_TOO_SHORT | SC_OVERLONG_3 | SC_SURROGATE,
+        SC_TOO_SHORT | SC_TOO_LARGE | SC_TOO_LARGE_1000 | SC_OVERLONG_4);
+    const __m256i byte_1_low = SC_TABLE(
+        (char)(SC_CARRY | SC_OVERLONG_3 | SC_OVERLONG_2 | SC_OVERLONG_4),
+        (char)(SC_CARRY | SC_OVERLONG_2), (char)SC_CARRY, (char)SC_CARRY,
+        (char)(SC_CARRY | SC_TOO_LARGE),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000 | SC_SURROGATE),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000),
+        (char)(SC_CARRY | SC_TOO_LARGE | SC_TOO_LARGE_1000));
+    const __m256i byte_2_high = SC_TABLE(
+        // ascii
+        SC_TOO_SHORT, SC_TOO_SHORT, SC_TOO_SHORT, SC_TOO_SHORT, SC_TOO_SHORT,
+        SC_TOO_SHORT, SC_TOO_SHORT, SC_TOO_SHORT,
+        // 1000, 1001, 1010, 1011
+        (char)(SC_TOO_LONG | SC_OVERLONG_2 | SC_TWO_CONTS | SC_OVERLONG_3 |
+               SC_TOO_LARGE_1000 | SC_OVERLONG_4),
+        (char)(SC_TOO_LONG | SC_OVERLONG_2 | SC_TWO_CONTS | SC_OVERLONG_3 |
+               SC_TOO_LARGE),
+        (char)(SC_TOO_LONG | SC_OVERLONG_2 | SC_TWO_CONTS | SC_SURROGATE |
+               SC_TOO_LARGE),
+        (char)(SC_TOO_LONG | SC_OVERLONG_2 | SC_TWO_CONTS | SC_SURROGATE |
+               SC_TOO_LARGE),
+        // leads
+        SC_TOO_SHORT, SC_TOO_SHORT, SC_TOO_SHORT, SC_TOO_SHORT);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i prev1 = SC_PREV(v, prev, 1);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(
+                byte_1_high,
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high,
+                            _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+
+    // the third and fourth bytes of a sequence must be continuations. those
+    // are the only places where SC_TWO_CONTS is fine.
+    __m256i third = _mm256_subs_epu8(SC_PREV(v, prev, 2),
+                                     _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(SC_PREV(v, prev, 3),
+                                      _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must_cont = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                         _mm256_set1_epi8((char)0x80));
+
+    return _mm256_xor_si256(must_cont, special);
+}
+
+__attribute__((target("avx2"))) static const char*
+sc_utf8_check_avx2(const char* p, const char* end) {
+    // a lead byte this close to the end of a block needs the next block
+    const __m256i max_tail = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+        (char)(0xE0 - 1), (char)(0xC0 - 1));
+
+    const char* begin = p;
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i err = _mm256_setzero_si256();
+
+    for (; p < end; p += 32) {
+        __m256i v;
+        if (end - p >= 32) {
+            v = _mm256_loadu_si256((const __m256i*)p);
+        } else {
+            // padded with nul, which is ascii, so a cut off character at the
+            // very end is too short
+            char buf[32] = {0};
+            memcpy(buf, p, end - p);
+            v = _mm256_loadu_si256((const __m256i*)buf);
+        }
+
+        if (_mm256_movemask_epi8(v) == 0) {
+            err = _mm256_or_si256(err, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            err = _mm256_or_si256(err, sc_utf8_errors_avx2(v, prev));
+            incomplete = _mm256_subs_epu8(v, max_tail);
+        }
+        prev = v;
+
+        if (!_mm256_testz_si256(err, err))
+            break;
+    }
+
+    err = _mm256_or_si256(err, incomplete);
+    if (_mm256_testz_si256(err, err))
+        return end;
+
+    // the error is in this block, or in a character that started at most 3
+    // bytes before it. find where that character starts and look closer.
+    const char* q = (p - begin > 3) ? p - 3 : begin;
+    while (q < p && (*q & 0xC0) == 0x80)
+        q++;
+
+    bool bad;
+    return sc_utf8_scalar(q, end, end, &bad);
+}
+
+#undef SC_PREV
+#undef SC_TABLE
+
+static inline bool sc_have_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // SC_SIMD
+
+const char* sc_skip_blanks(const char* p, const char* end) {
+    // most runs of blanks are a single space between two tokens, which is not
+    // worth setting up a vector for.
+    if (p >= end || !sc_is_blank(*p))
+        return p;
+    if (++p >= end || !sc_is_blank(*p))
+        return p;
+
+#ifdef SC_SIMD
+    if (sc_have_avx2())
+        return sc_skip_blanks_avx2(p, end);
+    else
+        return sc_skip_blanks_sse2(p, end);
+#else
+    return sc_skip_blanks_scalar(p, end);
+#endif
+}
+
+const char* sc_find(const char* p, const char* end, char ch) {
+    return sc_find2(p, end, ch, ch);
+}
+
+const char* sc_find2(const char* p, const char* end, char a, char b) {
+#ifdef SC_SIMD
+    if (sc_have_avx2())
+        return sc_find2_avx2(p, end, a, b);
+    else
+        return sc_find2_sse2(p, end, a, b);
+#else
+    return sc_find2_scalar(p, end, a, b);
+#endif
+}
+
+const char* sc_utf8_check(const char* p, const char* end) {
+#ifdef SC_SIMD
+    if (sc_have_avx2())
+        return sc_utf8_check_avx2(p, end);
+    else
+        return sc_utf8_check_sse2(p, end);
+#else
+    bool bad;
+    return sc_utf8_scalar(p, end, end, &bad);
+#endif
+}
+
+usize sc_count(const char* p, const char* end, char ch) {
+#ifdef SC_SIMD
+    if (sc_have_avx2())
+        return sc_count_avx2(p, end, ch);
+    else
+        return sc_count_sse2(p, end, ch);
+#else
+    return sc_count_scalar(p, end, ch);
+#endif
+}
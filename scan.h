@@ -0,0 +1,38 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _SCAN_H
+#define _SCAN_H
+
+#include "common.h"
+
+// vectorized byte scanners used by the lexer. SSE2 is used on every x86
+// target, AVX2 when the CPU supports it, and a plain loop everywhere else.
+//
+// all of them scan the range [p, end) and return `end` if nothing was found.
+// they never read past `end`.
+
+// skips blanks (spaces, tabs, \v, \f and \r, but not \n).
+const char* sc_skip_blanks(const char* p, const char* end);
+
+// finds the first occurrence of `ch`.
+const char* sc_find(const char* p, const char* end, char ch);
+
+// finds the first occurrence of either `a` or `b`.
+const char* sc_find2(const char* p, const char* end, char a, char b);
+
+// counts the occurrences of `ch`.
+usize sc_count(const char* p, const char* end, char ch);
+
+// finds the first byte of the first sequence that is not valid utf-8, or that
+// is cut off by `end`. overlong forms, surrogates and anything past U+10FFFF
+// are all invalid. `p` must not be in the middle of a character.
+const char* sc_utf8_check(const char* p, const char* end);
+
+#endif // _SCAN_H
@@ -0,0 +1,184 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "a_string.h"
+#include "common.h"
+#include "scan.h"
+#include "source.h"
+
+#define SF_READ_CHUNK 8192
+
+static bool sf_read_fd(SourceFile* res, int fd) {
+    a_string buf = as_with_capacity(SF_READ_CHUNK);
+
+    for (;;) {
+        if (buf.cap - buf.len < SF_READ_CHUNK)
+            as_reserve(&buf, buf.cap * 2);
+
+        isize got = read(fd, &buf.data[buf.len], buf.cap - buf.len - 1);
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            as_free(&buf);
+            return false;
+        } else if (got == 0) {
+            break;
+        }
+
+        buf.len += got;
+    }
+
+    buf.data[buf.len] = '\0';
+    *res = (SourceFile){.data = buf.data, .len = buf.len, .buf = buf};
+    return true;
+}
+
+bool sf_open_fd(SourceFile* res, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return false;
+
+    // mmap only makes sense for regular, non-empty files. (mapping 0 bytes is
+    // an error anyway.)
+    if (!S_ISREG(st.st_mode) || st.st_size == 0)
+        return sf_read_fd(res, fd);
+
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+        return sf_read_fd(res, fd);
+
+    // the lexer reads front to back, so let the kernel read ahead.
+    posix_madvise(p, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    *res = (SourceFile){
+        .data = p,
+        .len = st.st_size,
+        .mapped = true,
+    };
+    return true;
+}
+
+bool sf_open(SourceFile* res, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    bool ok = sf_open_fd(res, fd);
+
+    // the mapping stays valid after the descriptor is closed.
+    int err = errno;
+    close(fd);
+    errno = err;
+
+    return ok;
+}
+
+void sf_close(SourceFile* s) {
+    if (s->mapped)
+        munmap((void*)s->data, s->len);
+    else
+        as_free(&s->buf);
+
+    *s = (SourceFile){0};
+}
+
+u64 sf_hash(const SourceFile* s) {
+    return sf_hash_bytes(s->data, s->len);
+}
+
+// four words at a time, in four lanes that do not wait on each other, so the
+// multiplies overlap.
+u64 sf_hash_bytes(const void* data, usize len) {
+    const u64 k = 0xff51afd7ed558ccdULL;
+    const char* p = data;
+    u64 h[4] = {
+        len * 0x9E3779B97F4A7C15ULL,
+        len ^ 0xc4ceb9fe1a85ec53ULL,
+        len + 0x165667b19e3779f9ULL,
+        ~len,
+    };
+
+    for (; len >= 32; p += 32, len -= 32) {
+        for (u32 i = 0; i < 4; i++) {
+            u64 w;
+            memcpy(&w, p + i * 8, 8);
+            h[i] = (h[i] ^ w) * k;
+            h[i] ^= h[i] >> 32;
+        }
+    }
+
+    for (u32 i = 0; len > 0; i++) {
+        u64 w = 0;
+        u32 n = (len < 8) ? len : 8;
+        memcpy(&w, p, n);
+        h[i] = (h[i] ^ w) * k;
+        h[i] ^= h[i] >> 32;
+        p += n;
+        len -= n;
+    }
+
+    u64 res = h[0];
+    for (u32 i = 1; i < 4; i++) {
+        res = (res ^ h[i]) * k;
+        res ^= res >> 29;
+    }
+    return res;
+}
+
+LineTable lt_new(const char* src, usize len) {
+    return (LineTable){.src = src, .len = len};
+}
+
+// counts the lines first, so the table is allocated once at the right size.
+static void lt_build(LineTable* t) {
+    const char* end = t->src + t->len;
+    t->nlines = sc_count(t->src, end, '\n') + 1;
+    t->starts = malloc(sizeof(u32) * t->nlines);
+    check_alloc(t->starts);
+
+    t->starts[0] = 0;
+    const char* p = t->src;
+    for (u32 i = 1; i < t->nlines; i++) {
+        p = sc_find(p, end, '\n') + 1;
+        t->starts[i] = p - t->src;
+    }
+}
+
+LineCol lt_locate(LineTable* t, u32 off) {
+    if (t->nlines == 0)
+        lt_build(t);
+
+    // the last line that starts at or before `off`
+    u32 lo = 0, hi = t->nlines;
+    while (hi - lo > 1) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (t->starts[mid] <= off)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return (LineCol){.row = lo + 1, .col = off - t->starts[lo] + 1};
+}
+
+void lt_free(LineTable* t) {
+    free(t->starts);
+    *t = (LineTable){0};
+}
@@ -0,0 +1,68 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _SOURCE_H
+#define _SOURCE_H
+
+#include <stdbool.h>
+
+#include "a_string.h"
+#include "common.h"
+
+// a source file loaded into memory, ready to be handed to lx_new.
+typedef struct {
+    const char* data; // NOT null terminated!
+    usize len;
+
+    // internal
+    bool mapped; // data is a read only mapping of the file
+    a_string buf; // backing storage if the file was read instead
+} SourceFile;
+
+// loads a source file. regular files are mmap'd read only, so no copy is made
+// and the kernel pages the file in as the lexer goes. pipes, empty files and
+// other special files are read into memory instead.
+//
+// returns false and sets errno on error.
+bool sf_open(SourceFile* res, const char* path);
+
+// same as sf_open, but from an already open file descriptor, which is not
+// closed.
+bool sf_open_fd(SourceFile* res, int fd);
+
+void sf_close(SourceFile* s);
+
+// a 64 bit hash of the contents, the same from one run to the next, so it can
+// tell whether a file has changed.
+u64 sf_hash(const SourceFile* s);
+// the same hash, of any `len` bytes.
+u64 sf_hash_bytes(const void* data, usize len);
+
+// turns byte offsets into rows and columns, both counted from 1. the start of
+// every line is found on the first lookup, and each lookup after that is a
+// binary search.
+typedef struct {
+    const char* src;
+    usize len;
+
+    // internal
+    u32* starts; // offset of the first byte of each line
+    u32 nlines;  // 0 until the table is built
+} LineTable;
+
+typedef struct {
+    u32 row;
+    u32 col; // in bytes
+} LineCol;
+
+LineTable lt_new(const char* src, usize len);
+LineCol lt_locate(LineTable* t, u32 off);
+void lt_free(LineTable* t);
+
+#endif // _SOURCE_H
@@ -9,49 +9,30 @@
  */
 #define _POSIX_C_SOURCE 200809L
 
-#include <stdlib.h>
-
 #include "astcommon.h"
 #include "common.h"
 #include "expr.h"
 #include "stmt.h"
 
-C_BlockItem C_BlockItem_new_expr(struct C_Expr expr) {
-    C_BlockItem res = {0};
-    make(C_Expr, res.expr, expr);
-    return res;
-}
-
-C_BlockItem C_BlockItem_new_stmt(struct C_Stmt stmt) {
-    C_BlockItem res = {0};
-    make(C_Stmt, res.stmt, stmt);
-    return res;
+C_BlockItem C_BlockItem_new_expr(C_ExprId expr) {
+    return (C_BlockItem){.expr = expr};
 }
 
-AST_IMPL_FREE(C_BlockItem, itm) {
-    if (itm->stmt) {
-        C_Stmt_free(itm->stmt);
-        free(itm->stmt);
-    } else if (itm->expr) {
-        C_Expr_free(itm->expr);
-        free(itm->expr);
-    }
+C_BlockItem C_BlockItem_new_stmt(u32 stmt) {
+    return (C_BlockItem){.expr = C_EXPR_NONE, .stmt = stmt};
 }
 
-C_Block C_Block_new(C_BlockItem* items, u32 len) {
+C_Block C_Block_new(u32 items, u32 len) {
     return (C_Block){
         .items = items,
         .len = len,
     };
 }
 
-AST_IMPL_FREE(C_Block, b) {
-    for (u32 i = 0; i < b->len; ++i) {
-        C_BlockItem_free(&b->items[i]);
-    }
-    free(b->items);
-}
-
-AST_IMPL_FREE(C_Stmt, stmt) {
-    return;
+C_Include C_Include_new(Pos pos, u32 path, u32 path_len, u32 at) {
+    AST_INIT_NODE(C_Include);
+    res.path = path;
+    res.path_len = path_len;
+    res.at = at;
+    return res;
 }
@@ -12,30 +12,36 @@
 
 #include "astcommon.h"
 #include "common.h"
-
-// external
-struct C_Expr;
+#include "lexertypes.h"
 
 typedef struct C_BlockItem {
-    struct C_Expr* expr;
-    struct C_Stmt* stmt;
+    C_ExprId expr; // C_EXPR_NONE if it is a statement
+    u32 stmt;      // in the statement pool, once there are statements
 } C_BlockItem;
-AST_DECL_FREE(C_BlockItem);
 
-C_BlockItem C_BlockItem_new_expr(struct C_Expr expr);
-C_BlockItem C_BlockItem_new_stmt(struct C_Stmt stmt);
+C_BlockItem C_BlockItem_new_expr(C_ExprId expr);
+C_BlockItem C_BlockItem_new_stmt(u32 stmt);
 
 typedef struct C_Block {
-    C_BlockItem* items;
+    u32 items; // the first one in the block item pool
     u32 len;
 } C_Block;
-AST_DECL_FREE(C_Block);
 
-C_Block C_Block_new(C_BlockItem* items, u32 len);
+C_Block C_Block_new(u32 items, u32 len);
+
+// `include "path"`, which may only be on a line of its own at the top level
+// of a file.
+typedef struct C_Include {
+    u32 path; // into the string pool, null terminated
+    u32 path_len;
+    u32 at; // how many top level items come before it
+    Pos pos;
+} C_Include;
+
+C_Include C_Include_new(Pos pos, u32 path, u32 path_len, u32 at);
 
 typedef struct C_Stmt {
 
 } C_Stmt;
-AST_DECL_FREE(C_Stmt);
 
 #endif // _STMT_H
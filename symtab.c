@@ -0,0 +1,134 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "symtab.h"
+
+#define SYM_INITIAL_SLOTS 256
+
+SymbolTable sym_new(void) {
+    return (SymbolTable){0};
+}
+
+void sym_free(SymbolTable* t) {
+    free(t->names);
+    free(t->syms);
+    free(t->slots);
+    *t = (SymbolTable){0};
+}
+
+// hashes a word at a time. identifiers are short, so this is mostly one or two
+// multiplies.
+static u32 sym_hash(const char* s, u32 len) {
+    const u64 k = 0xff51afd7ed558ccdULL;
+    u64 h = len * 0x9E3779B97F4A7C15ULL;
+
+    for (; len >= 8; s += 8, len -= 8) {
+        u64 w;
+        memcpy(&w, s, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 32;
+    }
+
+    if (len > 0) {
+        u64 w = 0;
+        memcpy(&w, s, len);
+        h = (h ^ w) * k;
+        h ^= h >> 32;
+    }
+
+    return (u32)h;
+}
+
+// doubles the number of slots and puts every symbol back in. the hashes are
+// kept around, so no name is looked at again.
+static void sym_grow(SymbolTable* t) {
+    u32 nslots = (t->nslots != 0) ? t->nslots * 2 : SYM_INITIAL_SLOTS;
+    SymbolSlot* slots = calloc(nslots, sizeof(SymbolSlot));
+    check_alloc(slots);
+
+    u32 mask = nslots - 1;
+    for (u32 id = 0; id < t->len; id++) {
+        const Symbol* sym = &t->syms[id];
+        u32 i = sym->hash & mask;
+        while (slots[i].id != 0)
+            i = (i + 1) & mask;
+        slots[i] = (SymbolSlot){
+            .hash = sym->hash, .id = id + 1, .off = sym->off, .len = sym->len};
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->nslots = nslots;
+}
+
+static u32 sym_add(SymbolTable* t, const char* s, u32 len, u32 hash) {
+    if (t->len == t->cap) {
+        t->cap = (t->cap != 0) ? t->cap * 2 : 64;
+        t->syms = realloc(t->syms, sizeof(Symbol) * t->cap);
+        check_alloc(t->syms);
+    }
+
+    if (t->names_len + len + 1 > t->names_cap) {
+        usize cap = (t->names_cap != 0) ? t->names_cap : 1024;
+        while (cap < t->names_len + len + 1)
+            cap *= 2;
+        t->names = realloc(t->names, cap);
+        check_alloc(t->names);
+        t->names_cap = cap;
+    }
+
+    memcpy(&t->names[t->names_len], s, len);
+    t->names[t->names_len + len] = '\0';
+
+    u32 id = t->len++;
+    t->syms[id] = (Symbol){.off = t->names_len, .len = len, .hash = hash};
+    t->names_len += len + 1;
+    return id;
+}
+
+u32 sym_intern(SymbolTable* t, const char* s, u32 len) {
+    // keep the table at most half full
+    if (2 * (t->len + 1) > t->nslots)
+        sym_grow(t);
+
+    u32 hash = sym_hash(s, len);
+    u32 mask = t->nslots - 1;
+    u32 i = hash & mask;
+
+    for (; t->slots[i].id != 0; i = (i + 1) & mask) {
+        const SymbolSlot* slot = &t->slots[i];
+        if (slot->hash == hash && slot->len == len &&
+            !memcmp(&t->names[slot->off], s, len))
+            return slot->id - 1;
+    }
+
+    u32 id = sym_add(t, s, len, hash);
+    t->slots[i] = (SymbolSlot){
+        .hash = hash, .id = id + 1, .off = t->syms[id].off, .len = len};
+    return id;
+}
+
+const char* sym_name(const SymbolTable* t, u32 sym) {
+    if (sym >= t->len)
+        panic("symbol %u is not in the table", sym);
+    return &t->names[t->syms[sym].off];
+}
+
+u32 sym_len(const SymbolTable* t, u32 sym) {
+    if (sym >= t->len)
+        panic("symbol %u is not in the table", sym);
+    return t->syms[sym].len;
+}
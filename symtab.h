@@ -0,0 +1,64 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _SYMTAB_H
+#define _SYMTAB_H
+
+#include "common.h"
+
+// interned identifier names. every distinct name is stored once, and is known
+// by a u32 symbol id from then on, so names compare as integers. ids are handed
+// out in order from 0, and stay valid for as long as the table lives.
+//
+// a table is not thread safe. lexers that run side by side each get their own,
+// and merge them afterwards with sym_intern.
+
+typedef struct {
+    u32 off; // into `names`
+    u32 len;
+    u32 hash;
+} Symbol;
+
+// a slot in the hash table. it has a copy of the symbol, so a lookup only has
+// to go to the names once.
+typedef struct {
+    u32 hash;
+    u32 id; // symbol id plus one, or 0 if the slot is empty
+    u32 off;
+    u32 len;
+} SymbolSlot;
+
+typedef struct {
+    // every name, one after the other, each null terminated
+    char* names;
+    usize names_len;
+    usize names_cap;
+
+    Symbol* syms; // indexed by symbol id
+    u32 len;
+    u32 cap;
+
+    // open addressing with linear probing. the number of slots is a power of
+    // two.
+    SymbolSlot* slots;
+    u32 nslots;
+} SymbolTable;
+
+SymbolTable sym_new(void);
+void sym_free(SymbolTable* t);
+
+// gets the id of a name, adding it to the table if it is not in there yet.
+u32 sym_intern(SymbolTable* t, const char* s, u32 len);
+
+// the name behind a symbol id, null terminated. the pointer is only good until
+// the next call to sym_intern, the id is good forever.
+const char* sym_name(const SymbolTable* t, u32 sym);
+u32 sym_len(const SymbolTable* t, u32 sym);
+
+#endif // _SYMTAB_H
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+#
+# cimi: a scuffed scripting language
+#
+# Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# generates unicode_data.h, the identifier tables behind unicode.c, from the
+# unicode database that python was built with:
+#
+#   python3 tools/gen_unicode.py > unicode_data.h
+#
+# code points are looked up in two steps. the top bits pick a block of 256 code
+# points, and blocks that are the same are only stored once.
+
+import sys
+import unicodedata
+
+BLOCK = 256
+MAX = 0x110000
+
+
+def is_start(cp):
+    return chr(cp).isidentifier()
+
+
+def is_continue(cp):
+    return ("a" + chr(cp)).isidentifier()
+
+
+def bitmap(pred, base):
+    res = bytearray(BLOCK // 8)
+    for i in range(BLOCK):
+        cp = base + i
+        if not (0xD800 <= cp <= 0xDFFF) and pred(cp):
+            res[i // 8] |= 1 << (i % 8)
+    return bytes(res)
+
+
+blocks = {}
+index = []
+for base in range(0, MAX, BLOCK):
+    b = bitmap(is_start, base) + bitmap(is_continue, base)
+    index.append(blocks.setdefault(b, len(blocks)))
+
+assert len(blocks) <= 256
+
+out = sys.stdout
+out.write("// generated by tools/gen_unicode.py from unicode %s, do not edit.\n"
+          % unicodedata.unidata_version)
+out.write("#ifndef _UNICODE_DATA_H\n#define _UNICODE_DATA_H\n\n")
+out.write('#include "common.h"\n\n')
+out.write("#define UC_BLOCK_SHIFT 8\n\n")
+
+out.write("// block of each code point, by code point >> UC_BLOCK_SHIFT\n")
+out.write("static const u8 UC_BLOCKS[%d] = {\n" % len(index))
+for i in range(0, len(index), 16):
+    out.write("    " + ", ".join("%d" % x for x in index[i:i + 16]) + ",\n")
+out.write("};\n\n")
+
+out.write("// per block, a bitmap of XID_Start and then one of XID_Continue\n")
+out.write("static const u8 UC_BITS[%d][2][%d] = {\n" % (len(blocks), BLOCK // 8))
+for b in sorted(blocks, key=blocks.get):
+    half = BLOCK // 8
+    out.write("    {\n")
+    for part in (b[:half], b[half:]):
+        out.write("        {\n")
+        for i in range(0, half, 12):
+            out.write("            " +
+                      ", ".join("0x%02x" % x for x in part[i:i + 12]) + ",\n")
+        out.write("        },\n")
+    out.write("    },\n")
+out.write("};\n\n")
+
+out.write("#endif // _UNICODE_DATA_H\n")
@@ -0,0 +1,53 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+
+#include "common.h"
+#include "unicode.h"
+#include "unicode_data.h"
+
+u32 uc_decode(const char* s, u32* len) {
+    const u8* p = (const u8*)s;
+
+    if (p[0] < 0x80) {
+        *len = 1;
+        return p[0];
+    } else if (p[0] < 0xE0) {
+        *len = 2;
+        return (u32)(p[0] & 0x1F) << 6 | (p[1] & 0x3F);
+    } else if (p[0] < 0xF0) {
+        *len = 3;
+        return (u32)(p[0] & 0x0F) << 12 | (u32)(p[1] & 0x3F) << 6 |
+               (p[2] & 0x3F);
+    } else {
+        *len = 4;
+        return (u32)(p[0] & 0x07) << 18 | (u32)(p[1] & 0x3F) << 12 |
+               (u32)(p[2] & 0x3F) << 6 | (p[3] & 0x3F);
+    }
+}
+
+static bool uc_lookup(u32 cp, u32 which) {
+    if (cp >= 0x110000)
+        return false;
+
+    const u8* bits = UC_BITS[UC_BLOCKS[cp >> UC_BLOCK_SHIFT]][which];
+    u32 i = cp & ((1 << UC_BLOCK_SHIFT) - 1);
+    return (bits[i / 8] >> (i % 8)) & 1;
+}
+
+bool uc_is_ident_start(u32 cp) {
+    return uc_lookup(cp, 0);
+}
+
+bool uc_is_ident_continue(u32 cp) {
+    return uc_lookup(cp, 1);
+}
@@ -0,0 +1,26 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _UNICODE_H
+#define _UNICODE_H
+
+#include <stdbool.h>
+
+#include "common.h"
+
+// decodes the character at `s`, which must be valid utf-8 (see
+// sc_utf8_check), and sets `len` to the number of bytes it takes up.
+u32 uc_decode(const char* s, u32* len);
+
+// whether a code point may start or continue an identifier, as in unicode's
+// XID_Start and XID_Continue. the underscore counts as a start too.
+bool uc_is_ident_start(u32 cp);
+bool uc_is_ident_continue(u32 cp);
+
+#endif // _UNICODE_H
@@ -0,0 +1,101 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "writer.h"
+
+Writer wr_new(FILE* fp) {
+    Writer w = {.fp = fp, .cap = WR_BUF_SIZE};
+    w.buf = malloc(w.cap);
+    check_alloc(w.buf);
+    return w;
+}
+
+void wr_free(Writer* w) {
+    wr_flush(w);
+    free(w->buf);
+    *w = (Writer){0};
+}
+
+void wr_flush(Writer* w) {
+    if (w->len != 0 && fwrite(w->buf, 1, w->len, w->fp) != w->len)
+        panic("could not write output");
+    w->len = 0;
+    fflush(w->fp);
+}
+
+void wr_write(Writer* w, const void* data, usize len) {
+    if (w->len + len > w->cap) {
+        wr_flush(w);
+        // too big to be worth copying
+        if (len > w->cap) {
+            if (fwrite(data, 1, len, w->fp) != len)
+                panic("could not write output");
+            return;
+        }
+    }
+
+    memcpy(&w->buf[w->len], data, len);
+    w->len += len;
+}
+
+void wr_putc(Writer* w, char ch) {
+    if (w->len == w->cap)
+        wr_flush(w);
+    w->buf[w->len++] = ch;
+}
+
+void wr_cstr(Writer* w, const char* s) {
+    wr_write(w, s, strlen(s));
+}
+
+void wr_u32(Writer* w, u32 n) {
+    char buf[10];
+    usize i = sizeof(buf);
+    do {
+        buf[--i] = '0' + n % 10;
+        n /= 10;
+    } while (n != 0);
+    wr_write(w, &buf[i], sizeof(buf) - i);
+}
+
+void wr_i64(Writer* w, i64 n) {
+    char buf[20];
+    usize i = sizeof(buf);
+    // negated as unsigned, so INT64_MIN works too
+    u64 u = (n < 0) ? -(u64)n : (u64)n;
+    do {
+        buf[--i] = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (n < 0)
+        wr_putc(w, '-');
+    wr_write(w, &buf[i], sizeof(buf) - i);
+}
+
+#define WR_PRINTF_MAXSIZE 512
+void wr_printf(Writer* w, const char* restrict format, ...) {
+    char buf[WR_PRINTF_MAXSIZE];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if (len < 0)
+        panic("could not format output");
+    if ((usize)len >= sizeof(buf))
+        len = sizeof(buf) - 1;
+    wr_write(w, buf, len);
+}
@@ -0,0 +1,45 @@
+/*
+ * cimi: a scuffed scripting language
+ *
+ * Copyright (c) Eason Qin <eason@ezntek.com>, 2025.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _WRITER_H
+#define _WRITER_H
+
+#include <stdio.h>
+
+#include "common.h"
+
+// default size of a writer's buffer.
+#define WR_BUF_SIZE (64 * 1024)
+
+// buffers output to a stream, so that lots of small writes turn into a few big
+// ones. nothing is formatted with printf unless asked to.
+typedef struct {
+    FILE* fp;
+
+    // internal
+    char* buf;
+    usize len;
+    usize cap;
+} Writer;
+
+// the stream is not closed by wr_free.
+Writer wr_new(FILE* fp);
+// flushes whatever is left and frees the buffer.
+void wr_free(Writer* w);
+void wr_flush(Writer* w);
+
+void wr_write(Writer* w, const void* data, usize len);
+void wr_putc(Writer* w, char ch);
+void wr_cstr(Writer* w, const char* s);
+// integers in decimal.
+void wr_u32(Writer* w, u32 n);
+void wr_i64(Writer* w, i64 n);
+void wr_printf(Writer* w, const char* restrict format, ...);
+
+#endif // _WRITER_H